@@ -1,17 +1,65 @@
 #include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
 #include <curl/curl.h>
 #include "api.h"
 #include "cli.h"
+#include "json.h"
+#include "timing.h"
 
 #define SITENAME_MAX_LENGTH 32
+#define BATCH_INITIAL_BYTES 4194304
+#define BATCH_MIN_BYTES 262144
+#define BATCH_MAX_BYTES 67108864
+#define BATCH_TARGET_TIME 2.0 // seconds a batch should take to send
+#define BATCH_LATENCY_FACTOR 20 // connection latencies a batch should take to send, if that's longer
+#define BATCH_SMOOTHING 0.3 // weight of each new measurement in running averages
+#define RETRY_MAX 5 // retries of a request before giving up
+#define RETRY_BASE_DELAY 0.5 // seconds before the first retry, doubling with each one
+#define RETRY_MAX_DELAY 30.0
+#define CONCURRENCY_INITIAL 2 // requests in flight at the start of a batched method
+#define CONCURRENCY_SLOWDOWN 4 // how much slower than the fastest request a request can be before concurrency is cut
+#define CONCURRENCY_COST_BYTES 65536 // bytes added to each request's size when comparing their speeds, for their fixed cost
 #define ALLOWED_EXTENSION_COUNT 67
+#define EXTENSION_SLOTS 512 // slots in the extension hash table, a power of 2 comfortably above the extension count
+#define EXTENSION_SEED_MAX 65536 // seeds tried when building the hash table before falling back to a linear search
 #define ERROR_KEY_NULL "provide api key"
 #define ERROR_KEY_LENGTH "api key must be 32 characters in length"
 #define ERROR_SITENAME_LENGTH "sitename cannot exceed 32 characters"
 
 const char* allowed_extensions[ALLOWED_EXTENSION_COUNT] = {"apng", "asc", "atom", "avif", "bin", "cjs", "css", "csv", "dae", "eot", "epub", "geojson", "gif", "glb", "glsl", "gltf", "gpg", "htm", "html", "ico", "jpeg", "jpg", "js", "json", "key", "kml", "knowl", "less", "manifest", "map", "markdown", "md", "mf", "mid", "midi", "mjs", "mtl", "obj", "opml", "osdx", "otf", "pdf", "pgp", "pls", "png", "py", "rdf", "resolveHandle", "rss", "sass", "scss", "svg", "text", "toml", "ts", "tsv", "ttf", "txt", "webapp", "webmanifest", "webp", "woff", "woff2", "xcf", "xml", "yaml", "yml"};
 
+/* client */
+
+// a response buffer, grown geometrically and reused between requests
+struct APIBuffer {
+	char* data;
+	size_t length;
+	size_t cap;
+};
+
+// an easy handle with its own response buffer
+struct APIHandle {
+	CURL* curl;
+	struct APIBuffer response;
+};
+
+struct APIClient {
+	char* url; // base url that method names are appended to
+	struct curl_slist* headers; // authorization header, or null without a key
+	CURLSH* share; // dns, tls session + connection caches, shared by all of the client's handles
+	CURL* curl; // handle for single requests, kept alive between them
+	CURLM* multi; // handle for batched requests
+	struct APIHandle* pool; // handles for batched requests, reused between batches
+	size_t pool_size;
+	struct APIBuffer response;
+};
+
 /* curl helpers */
 
 // adds a key authorization header to a curl string list
@@ -22,171 +70,604 @@ struct curl_slist* curl_slist_append_key(struct curl_slist* list, const char* ke
 	return list;
 }
 
+// appends `size` bytes to a response buffer, keeping it null-terminated. returns 0 on success
+int buffer_append(struct APIBuffer* buffer, const char* data, size_t size) {
+	if (buffer->length + size >= buffer->cap) {
+		size_t cap = buffer->cap ? buffer->cap : 1024;
+		while (buffer->length + size >= cap) cap *= 2;
+		char* resized = realloc(buffer->data, cap);
+		if (!resized) return 1;
+		buffer->data = resized;
+		buffer->cap = cap;
+	}
+	memcpy(buffer->data + buffer->length, data, size);
+	buffer->data[buffer->length += size] = 0;
+	return 0;
+}
+
+// empties a response buffer for reuse. returns 0 on success
+int buffer_clear(struct APIBuffer* buffer) {
+	buffer->length = 0;
+	if (buffer_append(buffer, "", 0)) {print_error(ERROR_ALLOCATION); return 1;}
+	return 0;
+}
+
 // used as curl writefunction
-size_t curl_response_write(char* write, size_t size, size_t byte_count, char** string_p) {
-	size_t old_size = strlen(*string_p);
-	size_t write_size = size * byte_count;
-	char* string = realloc(*string_p, old_size + write_size + 1);
-	if (!string) {
-		free(*string_p);
-		return 0;
+size_t curl_response_write(char* write, size_t size, size_t byte_count, struct APIBuffer* buffer) {
+	return buffer_append(buffer, write, size * byte_count) ? 0 : size * byte_count;
+}
+
+// used as curl writefunction for streamed requests
+size_t curl_stream_write(char* write, size_t size, size_t byte_count, struct JSONStream* stream) {
+	return json_stream_feed(stream, write, size * byte_count) ? 0 : size * byte_count;
+}
+
+// clears `curl`'s options from any previous request, and sets the ones shared by all requests
+// the request is for `method` under the client's base url, with a `query` string that may be null
+// the handle keeps its connection + caches
+void curl_prepare(struct APIClient* client, CURL* curl, const char* method, const char* query, struct APIBuffer* response) {
+	char url[strlen(client->url) + strlen(method) + (query ? strlen(query) : 0) + 3];
+	sprintf(url, "%s/%s%s%s", client->url, method, query ? "?" : "", query ? query : "");
+	curl_easy_reset(curl);
+	curl_easy_setopt(curl, CURLOPT_SHARE, client->share);
+	curl_easy_setopt(curl, CURLOPT_URL, url);
+	// keeps idle connections open between requests that are far apart, as in watch mode
+	curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+	if (client->headers) curl_easy_setopt(curl, CURLOPT_HTTPHEADER, client->headers);
+	curl_easy_setopt(curl, CURLOPT_WRITEDATA, response);
+	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, curl_response_write);
+}
+
+// like `curl_prepare`, with a query string setting `name` to `value`, which is url-encoded
+// returns 0 on success, or 1 if memory couldn't be allocated
+int curl_prepare_query(struct APIClient* client, CURL* curl, const char* method, const char* name, const char* value, struct APIBuffer* response) {
+	char* escaped = curl_easy_escape(curl, value, 0);
+	if (!escaped) {print_error(ERROR_ALLOCATION); return 1;}
+	char query[strlen(name) + strlen(escaped) + 2];
+	sprintf(query, "%s=%s", name, escaped);
+	curl_free(escaped);
+	curl_prepare(client, curl, method, query, response);
+	return 0;
+}
+
+// records where a finished request spent its time, if timings are enabled
+void curl_record(CURL* curl) {
+	if (!timing_enabled()) return;
+	char* url = NULL;
+	curl_off_t namelookup = 0, connect = 0, appconnect = 0, starttransfer = 0, total = 0;
+	curl_off_t bytes_up = 0, bytes_down = 0, speed_up = 0, speed_down = 0;
+	curl_easy_getinfo(curl, CURLINFO_EFFECTIVE_URL, &url);
+	curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME_T, &namelookup);
+	curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &connect);
+	curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &appconnect);
+	curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &starttransfer);
+	curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &total);
+	curl_easy_getinfo(curl, CURLINFO_SIZE_UPLOAD_T, &bytes_up);
+	curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &bytes_down);
+	curl_easy_getinfo(curl, CURLINFO_SPEED_UPLOAD_T, &speed_up);
+	curl_easy_getinfo(curl, CURLINFO_SPEED_DOWNLOAD_T, &speed_down);
+	timing_request(url, namelookup / 1e6, connect / 1e6, appconnect / 1e6, starttransfer / 1e6, total / 1e6, bytes_up, bytes_down, speed_up, speed_down);
+}
+
+// returns how long to wait before retrying a request on `curl` that finished with `result`, after `attempt` earlier retries,
+// or a negative number if it shouldn't be retried.
+// transient network errors and overloaded or rate-limited responses are retried, backing off exponentially with jitter,
+// or for as long as the server asks with Retry-After
+double retry_delay(CURL* curl, CURLcode result, int attempt) {
+	if (attempt >= RETRY_MAX) return -1;
+	if (result) switch (result) {
+		case CURLE_COULDNT_RESOLVE_HOST: case CURLE_COULDNT_CONNECT: case CURLE_OPERATION_TIMEDOUT: case CURLE_SSL_CONNECT_ERROR:
+		case CURLE_SEND_ERROR: case CURLE_RECV_ERROR: case CURLE_GOT_NOTHING: case CURLE_PARTIAL_FILE: case CURLE_HTTP2: case CURLE_HTTP2_STREAM:
+			break;
+		default: return -1;
 	}
 	else {
-		*string_p = string;
-		strncpy(string + old_size, write, write_size);
-		return write_size;
+		long status = 0;
+		curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+		if (status != 429 && status != 502 && status != 503 && status != 504) return -1;
 	}
+	double delay = RETRY_BASE_DELAY * (1 << attempt);
+	if (delay > RETRY_MAX_DELAY) delay = RETRY_MAX_DELAY;
+	// spreading retries out, so requests that failed together don't come back together
+	delay = delay / 2 + delay / 2 * rand() / RAND_MAX;
+	curl_off_t retry_after = 0;
+	if (!result) curl_easy_getinfo(curl, CURLINFO_RETRY_AFTER, &retry_after);
+	return retry_after > delay ? retry_after : delay;
 }
 
-// performs an easy curl request and returns a string response
-char* curl_request(CURL* curl) {
-	char** response_ptr = malloc(sizeof(char*));
-	if (!response_ptr) {print_error(ERROR_ALLOCATION); return NULL;}
-	*response_ptr = malloc(1);
-	if (!*response_ptr) {print_error(ERROR_ALLOCATION); free(response_ptr); return NULL;}
-	**response_ptr = 0;
-	curl_easy_setopt(curl, CURLOPT_WRITEDATA, response_ptr);
-	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, curl_response_write);
+// reports a request on `curl` that finished with `result` being retried in `delay` seconds
+void retry_print(CURL* curl, CURLcode result, double delay) {
+	long status = 0;
+	curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+	if (result) print_error("curl error: %s, retrying in %.1fs", curl_easy_strerror(result), delay);
+	else print_error("server responded %ld, retrying in %.1fs", status, delay);
+}
 
-	CURLcode code = curl_easy_perform(curl);
-	if (code) print_error("curl error: %s", curl_easy_strerror(code));
+void retry_wait(double delay) {
+	struct timespec time = {delay, (delay - (long)delay) * 1e9};
+	while (nanosleep(&time, &time) && errno == EINTR);
+}
 
-	char* response = *response_ptr;
-	free(response_ptr);
-	return response;
+// performs the client's prepared easy request once, after `attempt` earlier tries
+// returns 0 if it finished, the seconds to wait before trying again if it can be retried, or -1 if it failed, after printing an error
+double curl_attempt(struct APIClient* client, int attempt) {
+	CURLcode code = curl_easy_perform(client->curl);
+	curl_record(client->curl);
+	double delay = retry_delay(client->curl, code, attempt);
+	if (delay > 0) {retry_print(client->curl, code, delay); return delay;}
+	if (code) {print_error("curl error: %s", curl_easy_strerror(code)); return -1;}
+	return 0;
+}
+
+// performs the client's prepared easy request, retrying it after transient failures
+// returns its response, or null if the request failed
+char* curl_request(struct APIClient* client) {
+	for (int attempt = 0;; attempt++) {
+		double delay = curl_attempt(client, attempt);
+		if (!delay) return client->response.data;
+		if (delay < 0 || buffer_clear(&client->response)) return NULL;
+		retry_wait(delay);
+	}
+}
+
+// attaches `files` to an upload request as multipart form data
+// returns the attached mime structure, or null if memory couldn't be allocated
+curl_mime* curl_mime_files(CURL* curl, size_t filec, const char** files) {
+	curl_mime* mime = curl_mime_init(curl);
+	if (!mime) return NULL;
+	for (size_t i = 0; i < filec; i++) {
+		curl_mimepart* part = curl_mime_addpart(mime);
+		if (!part) {curl_mime_free(mime); return NULL;}
+		curl_mime_name(part, files[i]);
+		curl_mime_filedata(part, files[i]);
+	}
+	curl_easy_setopt(curl, CURLOPT_MIMEPOST, mime);
+	return mime;
+}
+
+// attaches `files` to a delete request as url-encoded form data
+// returns the attached form, which must outlive the request, or null if memory couldn't be allocated
+char* curl_form_filenames(CURL* curl, size_t filec, const char** files) {
+	struct APIBuffer form = {0};
+	for (size_t i = 0; i < filec; i++) {
+		char* escaped = curl_easy_escape(curl, files[i], 0);
+		if (!escaped) goto error;
+		int error = (i && buffer_append(&form, "&", 1)) || buffer_append(&form, "filenames[]=", 12) || buffer_append(&form, escaped, strlen(escaped));
+		curl_free(escaped);
+		if (error) goto error;
+	}
+	curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long)form.length);
+	curl_easy_setopt(curl, CURLOPT_POSTFIELDS, form.data);
+	return form.data;
+	error:
+	free(form.data);
+	return NULL;
 }
 
 /* interface */
 
-char* api_info(const char* key, const char* sitename) {
-	if (!key && !sitename) {print_error(ERROR_KEY_NULL" or sitename"); return NULL;}
+struct APIClient* api_client_create(const char* key, const char* url) {
 	if (key && strlen(key) != KEY_LENGTH) {print_error(ERROR_KEY_LENGTH); return NULL;}
-	if (sitename && strlen(sitename) > SITENAME_MAX_LENGTH) {print_error(ERROR_SITENAME_LENGTH); return NULL;}
-	// creating curl
-	CURL* curl = curl_easy_init();
-	if (!curl) {print_error(ERROR_ALLOCATION); return NULL;}
-	// adding headers
-	struct curl_slist* headers = NULL;
-	if (key) {
-		headers = curl_slist_append_key(headers, key);
-		if (!headers) {print_error(ERROR_ALLOCATION); curl_easy_cleanup(curl); return NULL;}
-		curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+	struct APIClient* client = calloc(1, sizeof(struct APIClient));
+	if (!client) {print_error(ERROR_ALLOCATION); return NULL;}
+	if (!(client->url = strdup(url ? url : API_DEFAULT_URL))) goto error;
+	// trailing slashes would double up with the one before each method
+	for (size_t length = strlen(client->url); length && client->url[length - 1] == '/'; length--) client->url[length - 1] = 0;
+	if (key && !(client->headers = curl_slist_append_key(NULL, key))) goto error;
+	if (!(client->share = curl_share_init())) goto error;
+	curl_share_setopt(client->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+	curl_share_setopt(client->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+	curl_share_setopt(client->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+	if (!(client->curl = curl_easy_init())) goto error;
+	if (!(client->multi = curl_multi_init())) goto error;
+	return client;
+	error:
+	print_error(ERROR_ALLOCATION);
+	api_client_destroy(client);
+	return NULL;
+}
+
+void api_client_destroy(struct APIClient* client) {
+	if (!client) return;
+	for (size_t i = 0; i < client->pool_size; i++) {
+		curl_easy_cleanup(client->pool[i].curl);
+		free(client->pool[i].response.data);
 	}
+	free(client->pool);
+	if (client->multi) curl_multi_cleanup(client->multi);
+	if (client->curl) curl_easy_cleanup(client->curl);
+	if (client->share) curl_share_cleanup(client->share);
+	curl_slist_free_all(client->headers);
+	free(client->response.data);
+	free(client->url);
+	free(client);
+}
+
+char* api_info(struct APIClient* client, const char* sitename) {
+	if (!client->headers && !sitename) {print_error(ERROR_KEY_NULL" or sitename"); return NULL;}
+	if (sitename && strlen(sitename) > SITENAME_MAX_LENGTH) {print_error(ERROR_SITENAME_LENGTH); return NULL;}
+	if (buffer_clear(&client->response)) return NULL;
 	// building url
 	if (sitename) {
-		char url[41 + SITENAME_MAX_LENGTH] = "https://neocities.org/api/info?sitename=";
-		strncat(url, sitename, SITENAME_MAX_LENGTH);
-		curl_easy_setopt(curl, CURLOPT_URL, url);
+		if (curl_prepare_query(client, client->curl, "info", "sitename", sitename, &client->response)) return NULL;
+		// the key isn't needed to look up a site by name
+		curl_easy_setopt(client->curl, CURLOPT_HTTPHEADER, NULL);
 	}
-	else curl_easy_setopt(curl, CURLOPT_URL, "https://neocities.org/api/info");
+	else curl_prepare(client, client->curl, "info", NULL, &client->response);
 	// performing request
-	char* response = curl_request(curl);
-	// cleanup
-	curl_easy_cleanup(curl);
-	if (headers) curl_slist_free_all(headers);
-	return response;
+	return curl_request(client);
 }
 
-char* api_list(const char* key, const char* directory) {
-	if (!key) {print_error(ERROR_KEY_NULL); return NULL;}
-	if (strlen(key) != KEY_LENGTH) {print_error(ERROR_KEY_LENGTH); return NULL;}
-	// creating curl
-	CURL* curl = curl_easy_init();
-	if (!curl) {print_error(ERROR_ALLOCATION); return NULL;}
-	// adding headers
-	struct curl_slist* headers = curl_slist_append_key(NULL, key);
-	if (!headers) {print_error(ERROR_ALLOCATION); curl_easy_cleanup(curl); return NULL;}
-	curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-	// building url
-	if (directory) {
-		char url[37 + strlen(directory)];
-		strcpy(url, "https://neocities.org/api/list?path=");
-		strcat(url, directory);
-		curl_easy_setopt(curl, CURLOPT_URL, url);
-	}
-	else curl_easy_setopt(curl, CURLOPT_URL, "https://neocities.org/api/list");
+// prepares a list request for `directory`, which may be null
+// returns 0 on success, or 1 if memory couldn't be allocated
+int curl_prepare_list(struct APIClient* client, const char* directory) {
+	if (directory) return curl_prepare_query(client, client->curl, "list", "path", directory, &client->response);
+	curl_prepare(client, client->curl, "list", NULL, &client->response);
+	return 0;
+}
+
+char* api_list(struct APIClient* client, const char* directory) {
+	if (!client->headers) {print_error(ERROR_KEY_NULL); return NULL;}
+	if (buffer_clear(&client->response)) return NULL;
+	if (curl_prepare_list(client, directory)) return NULL;
 	// performing request
-	char* response = curl_request(curl);
-	// cleanup
-	curl_easy_cleanup(curl);
-	curl_slist_free_all(headers);
-	return response;
+	return curl_request(client);
+}
+
+// passes streamed values on, counting them. a request that's passed values on can't be retried without repeating them
+struct StreamCounter {
+	int(*callback)(const char* json, void* data);
+	void* data;
+	size_t count;
+};
+
+int stream_count(const char* json, void* data) {
+	struct StreamCounter* counter = data;
+	counter->count++;
+	return counter->callback(json, counter->data);
+}
+
+char* api_list_stream(struct APIClient* client, const char* directory, int(*callback)(const char* json, void* data), void* data) {
+	if (!client->headers) {print_error(ERROR_KEY_NULL); return NULL;}
+	struct StreamCounter counter = {callback, data, 0};
+	for (int attempt = 0;; attempt++) {
+		if (buffer_clear(&client->response)) return NULL;
+		struct JSONStream* stream = json_stream_create("files", stream_count, &counter);
+		if (!stream) {print_error(ERROR_ALLOCATION); return NULL;}
+		if (curl_prepare_list(client, directory)) {json_stream_destroy(stream); return NULL;}
+		curl_easy_setopt(client->curl, CURLOPT_WRITEDATA, stream);
+		curl_easy_setopt(client->curl, CURLOPT_WRITEFUNCTION, curl_stream_write);
+		// performing request
+		double delay = curl_attempt(client, counter.count ? RETRY_MAX : attempt);
+		char* response = NULL;
+		// keeping the rest of the response, which is small without its files
+		if (!delay) {
+			const char* rest = json_stream_rest(stream);
+			if (buffer_append(&client->response, rest, strlen(rest))) print_error(ERROR_ALLOCATION);
+			else response = client->response.data;
+		}
+		json_stream_destroy(stream);
+		if (delay <= 0) return response;
+		retry_wait(delay);
+	}
 }
 
-char* api_upload(const char* key, size_t filec, const char** files) {
-	if (!key) {print_error(ERROR_KEY_NULL); return NULL;}
-	if (strlen(key) != KEY_LENGTH) {print_error(ERROR_KEY_LENGTH); return NULL;}
+char* api_upload(struct APIClient* client, size_t filec, const char** files) {
+	if (!client->headers) {print_error(ERROR_KEY_NULL); return NULL;}
 	if (!filec) {print_error("provide files"); return NULL;}
-	// creating curl
-	CURL* curl = curl_easy_init();
-	if (!curl) {print_error(ERROR_ALLOCATION); return NULL;}
-	// adding headers
-	struct curl_slist* headers = curl_slist_append_key(NULL, key);
-	if (!headers) {print_error(ERROR_ALLOCATION); curl_easy_cleanup(curl); return NULL;}
-	curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+	if (buffer_clear(&client->response)) return NULL;
+	curl_prepare(client, client->curl, "upload", NULL, &client->response);
 	// adding files
-	curl_mime* mime = curl_mime_init(curl);
-	if (!mime) {print_error(ERROR_ALLOCATION); curl_easy_cleanup(curl); curl_slist_free_all(headers); return NULL;}
-	for (size_t i = 0; i < filec; i++) {
-		curl_mimepart* part = curl_mime_addpart(mime);
-		if (!part) {print_error(ERROR_ALLOCATION); curl_easy_cleanup(curl); curl_slist_free_all(headers); curl_mime_free(mime); return NULL;}
-		curl_mime_name(part, files[i]);
-		curl_mime_filedata(part, files[i]);
-	}
-	curl_easy_setopt(curl, CURLOPT_MIMEPOST, mime);
+	curl_mime* mime = curl_mime_files(client->curl, filec, files);
+	if (!mime) {print_error(ERROR_ALLOCATION); return NULL;}
 	// performing request
-	curl_easy_setopt(curl, CURLOPT_URL, "https://neocities.org/api/upload");
-	char* response = curl_request(curl);
+	char* response = curl_request(client);
 	// cleanup
-	curl_easy_cleanup(curl);
-	curl_slist_free_all(headers);
+	curl_easy_setopt(client->curl, CURLOPT_MIMEPOST, NULL);
 	curl_mime_free(mime);
 	return response;
 }
 
-char* api_delete(const char* key, size_t filec, const char** files) {
-	if (!key) {print_error(ERROR_KEY_NULL); return NULL;}
-	if (strlen(key) != KEY_LENGTH) {print_error(ERROR_KEY_LENGTH); return NULL;}
+/* a single request in a batched method */
+struct Batch {
+	struct APIHandle* handle;
+	curl_mime* mime; // upload form, or null
+	char* form; // delete form, or null
+	size_t first;
+	size_t filec;
+	int64_t bytes; // total size of the batch's files
+	int attempt; // retries so far
+	double started; // when the request was first sent
+	double retry_at; // when the request is sent again after failing, or 0 while it's in flight
+};
+
+// sizes batches as they're started, from how earlier batches went
+// batches are bounded by a file count and a byte target, which follows the measured throughput,
+// so each takes about as long to send whatever the link. files over the target are sent alone
+struct BatchPlan {
+	const int64_t* sizes; // size of each file, or null to bound batches by count alone
+	size_t filec;
+	size_t next; // first file not yet in a batch
+	size_t batch_size; // most files in a batch
+	double target; // bytes per batch
+	double throughput; // average bytes per second of batches near the target, or 0 before one finishes
+	double latency; // average connect time of new connections in seconds, or 0 before one connects
+};
+
+// fills `batch` with the next files in `plan`. returns 0 if every file is already in a batch
+int batch_plan_next(struct BatchPlan* plan, struct Batch* batch) {
+	batch->first = plan->next;
+	batch->filec = 0;
+	batch->bytes = 0;
+	while (plan->next < plan->filec && batch->filec < plan->batch_size) {
+		int64_t size = plan->sizes ? plan->sizes[plan->next] : 0;
+		if (batch->filec && batch->bytes + size > plan->target) break;
+		batch->bytes += size;
+		batch->filec++;
+		plan->next++;
+	}
+	return batch->filec != 0;
+}
+
+// updates `plan` from a finished `batch`, which was sent by `curl`, or failed if `failed`
+void batch_plan_measure(struct BatchPlan* plan, const struct Batch* batch, CURL* curl, int failed) {
+	if (!plan->sizes) return;
+	// a failed batch may have timed out, so the next ones are kept smaller
+	if (failed) {
+		plan->target /= 2;
+		if (plan->target < BATCH_MIN_BYTES) plan->target = BATCH_MIN_BYTES;
+		return;
+	}
+	curl_off_t connect = 0, total = 0;
+	curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &connect);
+	curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &total);
+	// reused connections report no connect time
+	if (connect > 0) plan->latency = plan->latency ? plan->latency * (1 - BATCH_SMOOTHING) + connect / 1e6 * BATCH_SMOOTHING : connect / 1e6;
+	// batches of a few small files are mostly latency, and say little about throughput
+	if (total <= 0 || batch->bytes < plan->target / 2) return;
+	double throughput = batch->bytes / (total / 1e6);
+	plan->throughput = plan->throughput ? plan->throughput * (1 - BATCH_SMOOTHING) + throughput * BATCH_SMOOTHING : throughput;
+	double time = plan->latency * BATCH_LATENCY_FACTOR > BATCH_TARGET_TIME ? plan->latency * BATCH_LATENCY_FACTOR : BATCH_TARGET_TIME;
+	plan->target = plan->throughput * time;
+	if (plan->target < BATCH_MIN_BYTES) plan->target = BATCH_MIN_BYTES;
+	if (plan->target > BATCH_MAX_BYTES) plan->target = BATCH_MAX_BYTES;
+}
+
+// starts the request for `batch` of `method` ("upload" or "delete") on an idle pooled handle. returns 0 on success
+int batch_start(struct Batch* batch, struct APIClient* client, struct APIHandle* handle, const char* method, const char** files) {
+	batch->handle = handle;
+	if (buffer_clear(&handle->response)) return 1;
+	curl_prepare(client, handle->curl, method, NULL, &handle->response);
+	curl_easy_setopt(handle->curl, CURLOPT_PRIVATE, batch);
+	if (!strcmp(method, "upload")) {if (!(batch->mime = curl_mime_files(handle->curl, batch->filec, files + batch->first))) return 1;}
+	else if (!(batch->form = curl_form_filenames(handle->curl, batch->filec, files + batch->first))) return 1;
+	return curl_multi_add_handle(client->multi, handle->curl) != CURLM_OK;
+}
+
+// returns the batch's handle to the idle pool
+void batch_cleanup(struct Batch* batch, struct APIClient* client, struct APIHandle** idle, size_t* idle_count) {
+	curl_multi_remove_handle(client->multi, batch->handle->curl);
+	idle[(*idle_count)++] = batch->handle;
+	curl_mime_free(batch->mime);
+	free(batch->form);
+	batch->handle = NULL;
+	batch->mime = NULL;
+	batch->form = NULL;
+}
+
+// the number of requests a batched method keeps in flight, grown by about one for each round of successful requests,
+// and halved when one fails with a transient error, is rate-limited, or is much slower per byte than the fastest
+struct Concurrency {
+	double limit;
+	double max;
+	double cost_min; // the fewest seconds per byte a request has taken, or 0 before one finishes
+	double cut; // when the limit was last halved
+};
+
+// updates `concurrency` from a finished `batch`, sent by `curl`, which failed and will be retried if `retried`
+void concurrency_measure(struct Concurrency* concurrency, const struct Batch* batch, CURL* curl, int retried) {
+	int congested = retried;
+	if (!congested) {
+		curl_off_t pretransfer = 0, starttransfer = 0, bytes = 0;
+		curl_easy_getinfo(curl, CURLINFO_PRETRANSFER_TIME_T, &pretransfer);
+		curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &starttransfer);
+		curl_easy_getinfo(curl, CURLINFO_SIZE_UPLOAD_T, &bytes);
+		double cost = (starttransfer - pretransfer) / 1e6 / (bytes + CONCURRENCY_COST_BYTES);
+		if (cost > 0 && (!concurrency->cost_min || cost < concurrency->cost_min)) concurrency->cost_min = cost;
+		congested = cost > concurrency->cost_min * CONCURRENCY_SLOWDOWN;
+	}
+	if (!congested) {
+		concurrency->limit += 1 / concurrency->limit;
+		if (concurrency->limit > concurrency->max) concurrency->limit = concurrency->max;
+	}
+	// requests sent before the last cut were slowed by the old limit, so they don't cut it again
+	else if (batch->started >= concurrency->cut) {
+		concurrency->limit /= 2;
+		if (concurrency->limit < 1) concurrency->limit = 1;
+		concurrency->cut = timing_now();
+	}
+}
+
+// performs `method` on `files` in concurrent batches. see `api_upload_batched`
+// uploads are bounded by bytes as well as by file count
+size_t api_batched(struct APIClient* client, const char* method, size_t filec, const char** files, size_t batch_size, size_t connections, void(*callback)(const char** files, size_t filec, const char* response, void* data), void* data) {
+	if (!client->headers) {print_error(ERROR_KEY_NULL); return filec;}
+	if (!filec) {print_error("provide files"); return 0;}
+	if (!batch_size) batch_size = 1;
+	if (!connections) connections = 1;
+	if (connections > filec) connections = filec;
+	// measuring files to upload
+	struct BatchPlan plan = {NULL, filec, 0, batch_size, BATCH_INITIAL_BYTES, 0, 0};
+	int64_t* sizes = NULL;
+	if (!strcmp(method, "upload")) {
+		if (!(sizes = malloc(filec * sizeof(int64_t)))) {print_error(ERROR_ALLOCATION); return filec;}
+		struct stat statbuf;
+		for (size_t i = 0; i < filec; i++) sizes[i] = stat(files[i], &statbuf) ? 0 : statbuf.st_size;
+		plan.sizes = sizes;
+	}
+	// one batch for each request in flight, which is free while its handle is null
+	struct Batch* batches = calloc(connections, sizeof(struct Batch));
+	if (!batches) {print_error(ERROR_ALLOCATION); free(sizes); return filec;}
+	// growing the handle pool to fit `connections`
+	if (client->pool_size < connections) {
+		struct APIHandle* pool = realloc(client->pool, connections * sizeof(struct APIHandle));
+		if (!pool) {print_error(ERROR_ALLOCATION); free(batches); free(sizes); return filec;}
+		client->pool = pool;
+		while (client->pool_size < connections && (pool[client->pool_size].curl = curl_easy_init()))
+			pool[client->pool_size++].response = (struct APIBuffer){0};
+		if (!client->pool_size) {print_error(ERROR_ALLOCATION); free(batches); free(sizes); return filec;}
+		if (connections > client->pool_size) connections = client->pool_size;
+	}
+	struct APIHandle* idle[connections];
+	size_t idle_count = connections;
+	for (size_t i = 0; i < connections; i++) idle[i] = &client->pool[i];
+	// performing requests, keeping up to `connections` in flight (or waiting to be retried)
+	struct Concurrency concurrency = {connections < CONCURRENCY_INITIAL ? connections : CONCURRENCY_INITIAL, connections, 0, 0};
+	size_t failed = 0;
+	size_t running = 0;
+	while (plan.next < filec || running) {
+		double now = timing_now();
+		double wait = 1; // seconds until a failed request is retried, at most
+		for (size_t i = 0; i < connections; i++) {
+			struct Batch* batch = &batches[i];
+			// resending failed requests once they've waited
+			if (batch->handle && batch->retry_at) {
+				if (batch->retry_at > now) {
+					if (batch->retry_at - now < wait) wait = batch->retry_at - now;
+					continue;
+				}
+				batch->retry_at = 0;
+				if (buffer_clear(&batch->handle->response) || curl_multi_add_handle(client->multi, batch->handle->curl) != CURLM_OK) {
+					print_error(ERROR_ALLOCATION);
+					callback(files + batch->first, batch->filec, NULL, data);
+					batch_cleanup(batch, client, idle, &idle_count);
+					failed += batch->filec;
+					running--;
+				}
+				continue;
+			}
+			if (batch->handle || !idle_count || running >= (size_t)concurrency.limit || !batch_plan_next(&plan, batch)) continue;
+			batch->attempt = 0;
+			batch->started = now;
+			if (batch_start(batch, client, idle[--idle_count], method, files)) {
+				print_error(ERROR_ALLOCATION);
+				batch_cleanup(batch, client, idle, &idle_count);
+				callback(files + batch->first, batch->filec, NULL, data);
+				failed += batch->filec;
+			}
+			else running++;
+		}
+		int still_running;
+		CURLMcode code = curl_multi_perform(client->multi, &still_running);
+		if (code) {print_error("curl error: %s", curl_multi_strerror(code)); break;}
+		// reporting finished batches
+		CURLMsg* msg;
+		int msgs_left;
+		int finished = 0;
+		while ((msg = curl_multi_info_read(client->multi, &msgs_left))) {
+			if (msg->msg != CURLMSG_DONE) continue;
+			finished = 1;
+			struct Batch* batch;
+			curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char**)&batch);
+			CURLcode result = msg->data.result;
+			curl_record(msg->easy_handle);
+			double delay = retry_delay(msg->easy_handle, result, batch->attempt);
+			concurrency_measure(&concurrency, batch, msg->easy_handle, delay > 0);
+			if (delay > 0) {
+				if (result) batch_plan_measure(&plan, batch, msg->easy_handle, 1);
+				retry_print(msg->easy_handle, result, delay);
+				curl_multi_remove_handle(client->multi, msg->easy_handle);
+				batch->attempt++;
+				batch->retry_at = timing_now() + delay;
+				if (delay < wait) wait = delay;
+				continue;
+			}
+			batch_plan_measure(&plan, batch, msg->easy_handle, result != CURLE_OK);
+			if (result) {print_error("curl error: %s", curl_easy_strerror(result)); failed += batch->filec;}
+			callback(files + batch->first, batch->filec, result ? NULL : batch->handle->response.data, data);
+			batch_cleanup(batch, client, idle, &idle_count);
+			running--;
+		}
+		// waiting for activity, or for the next retry, unless a handle was just freed for another batch
+		if (running && !finished && (code = curl_multi_poll(client->multi, NULL, 0, wait * 1000 + 1, NULL))) {print_error("curl error: %s", curl_multi_strerror(code)); break;}
+	}
+	// cleanup, reporting any batches cut short by an error
+	for (size_t i = 0; i < connections; i++) if (batches[i].handle) {
+		callback(files + batches[i].first, batches[i].filec, NULL, data);
+		batch_cleanup(&batches[i], client, idle, &idle_count);
+		failed += batches[i].filec;
+	}
+	failed += filec - plan.next;
+	free(batches);
+	free(sizes);
+	return failed;
+}
+
+size_t api_upload_batched(struct APIClient* client, size_t filec, const char** files, size_t batch_size, size_t connections, void(*callback)(const char** files, size_t filec, const char* response, void* data), void* data) {
+	return api_batched(client, "upload", filec, files, batch_size, connections, callback, data);
+}
+
+char* api_delete(struct APIClient* client, size_t filec, const char** files) {
+	if (!client->headers) {print_error(ERROR_KEY_NULL); return NULL;}
 	if (!filec) {print_error("provide files"); return NULL;}
-	// creating curl
-	CURL* curl = curl_easy_init();
-	if (!curl) {print_error(ERROR_ALLOCATION); return NULL;}
-	// adding headers
-	struct curl_slist* headers = curl_slist_append_key(NULL, key);
-	if (!headers) {print_error(ERROR_ALLOCATION); curl_easy_cleanup(curl); return NULL;}
-	curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+	if (buffer_clear(&client->response)) return NULL;
+	curl_prepare(client, client->curl, "delete", NULL, &client->response);
 	// adding files
-	size_t files_total_size = 0;
-	for (int i = 0; i < filec; i++) files_total_size += strlen(files[i]);
-	char* fields = malloc(files_total_size + 13 * filec);
-	if (!fields) {print_error(ERROR_ALLOCATION); curl_easy_cleanup(curl); curl_slist_free_all(headers); return NULL;}
-	*fields = 0;
-	for (size_t i = 0; i < filec; i++) {
-		if (i) strcat(fields, "&");
-		strcat(fields, "filenames[]=");
-		strcat(fields, files[i]);
-	}
-	curl_easy_setopt(curl, CURLOPT_POSTFIELDS, fields);
+	char* form = curl_form_filenames(client->curl, filec, files);
+	if (!form) {print_error(ERROR_ALLOCATION); return NULL;}
 	// performing request
-	curl_easy_setopt(curl, CURLOPT_URL, "https://neocities.org/api/delete");
-	char* response = curl_request(curl);
+	char* response = curl_request(client);
 	// cleanup
-	curl_easy_cleanup(curl);
-	curl_slist_free_all(headers);
-	free(fields);
+	free(form);
 	return response;
 }
 
+size_t api_delete_batched(struct APIClient* client, size_t filec, const char** files, size_t batch_size, size_t connections, void(*callback)(const char** files, size_t filec, const char* response, void* data), void* data) {
+	return api_batched(client, "delete", filec, files, batch_size, connections, callback, data);
+}
+
 /* extras */
 
-// binary searches `allowed_extensions` for `extension`
-int api_is_extension_allowed(const char* extension) {
-	size_t start = 0;
-	size_t end = ALLOWED_EXTENSION_COUNT - 1;
-	while (start != end) {
-		size_t i = start + (end - start + 1) / 2;
-		if (strcmp(allowed_extensions[i], extension) > 0) end = i - 1;
-		else start = i;
+// a perfect hash table over `allowed_extensions`, built on first use by trying seeds until no two extensions share a slot.
+// each slot holds an index into `allowed_extensions` plus 1, or 0 if it's empty
+struct ExtensionTable {
+	uint32_t seed; // 0 if no seed worked, and extensions are searched linearly
+	unsigned char slots[EXTENSION_SLOTS];
+	unsigned char lengths[ALLOWED_EXTENSION_COUNT];
+} extension_table;
+pthread_once_t extension_table_once = PTHREAD_ONCE_INIT;
+
+// returns the slot of the `length`-character `extension`, ignoring case
+size_t extension_slot(const char* extension, size_t length, uint32_t seed) {
+	uint32_t hash = seed;
+	for (size_t i = 0; i < length; i++) {
+		unsigned char c = extension[i];
+		hash = (hash ^ (c >= 'A' && c <= 'Z' ? c + 'a' - 'A' : c)) * 16777619;
+	}
+	return (hash ^ hash >> 16) & (EXTENSION_SLOTS - 1);
+}
+
+void extension_table_build(void) {
+	for (size_t i = 0; i < ALLOWED_EXTENSION_COUNT; i++) extension_table.lengths[i] = strlen(allowed_extensions[i]);
+	for (uint32_t seed = 2166136261u; seed != 2166136261u + EXTENSION_SEED_MAX; seed++) {
+		memset(extension_table.slots, 0, EXTENSION_SLOTS);
+		size_t i = 0;
+		for (; i < ALLOWED_EXTENSION_COUNT; i++) {
+			unsigned char* slot = &extension_table.slots[extension_slot(allowed_extensions[i], extension_table.lengths[i], seed)];
+			if (*slot) break;
+			*slot = i + 1;
+		}
+		if (i == ALLOWED_EXTENSION_COUNT) {extension_table.seed = seed; return;}
+	}
+}
+
+int api_is_extension_allowed(const char* extension, size_t length) {
+	pthread_once(&extension_table_once, extension_table_build);
+	if (!extension_table.seed) {
+		for (size_t i = 0; i < ALLOWED_EXTENSION_COUNT; i++)
+			if (extension_table.lengths[i] == length && !strncasecmp(allowed_extensions[i], extension, length)) return 1;
+		return 0;
 	}
-	return !strcmp(allowed_extensions[start], extension);
+	size_t i = extension_table.slots[extension_slot(extension, length, extension_table.seed)];
+	return i && extension_table.lengths[--i] == length && !strncasecmp(allowed_extensions[i], extension, length);
 }
\ No newline at end of file
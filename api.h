@@ -1,23 +1,55 @@
 /* api interface */
 
 #define KEY_LENGTH 32
+#define API_DEFAULT_URL "https://neocities.org/api"
+
+/* client
+   a client holds the api key and keeps its connection, dns + tls session caches alive between requests,
+   so a sequence of methods only connects once. reuse one client for as many requests as possible */
+
+struct APIClient;
+
+// creates a client. `key` may be null, but only `api_info` can then be used with a sitename
+// requests go to `url` (eg. "https://neocities.org/api"), or to the neocities api if it's null
+// returns null on failure
+struct APIClient* api_client_create(const char* key, const char* url);
+
+void api_client_destroy(struct APIClient* client);
 
 /* api methods.
    all functions return a json string response, or null if the method failed.
+   requests that fail with transient errors, or are rate-limited, are retried a few times, backing off between tries.
+   the response is owned by the client, and is only valid until the client's next request.
    see https://neocities.org/api for more information on the api methods */
 
-// either `key` or `sitename` may be null, but not both.
-char* api_info(const char* key, const char* sitename);
+// `sitename` may be null if the client has a key
+char* api_info(struct APIClient* client, const char* sitename);
 
 // `directory` may be null.
-char* api_list(const char* key, const char* directory);
+char* api_list(struct APIClient* client, const char* directory);
+
+// like `api_list`, but passes each file's json object to `callback` as soon as it arrives, instead of keeping it in the response.
+// `callback` returns nonzero to cancel the request
+char* api_list_stream(struct APIClient* client, const char* directory, int(*callback)(const char* json, void* data), void* data);
+
+char* api_upload(struct APIClient* client, size_t filec, const char** files);
+
+// uploads `files` in batches of up to `batch_size` files, with up to `connections` requests in flight at once.
+// batches are also bounded by bytes, adapting to the throughput of earlier batches, and large files are sent alone.
+// the number in flight starts lower, growing while requests succeed and halving when they fail, are rate-limited or slow down.
+// failed requests are retried like single ones.
+// `callback` is called with each batch's files and json response as the batch completes.
+// the response is null if the request failed, and is only valid until `callback` returns.
+// returns the number of files that couldn't be sent
+size_t api_upload_batched(struct APIClient* client, size_t filec, const char** files, size_t batch_size, size_t connections, void(*callback)(const char** files, size_t filec, const char* response, void* data), void* data);
 
-char* api_upload(const char* key, size_t filec, const char** files);
+char* api_delete(struct APIClient* client, size_t filec, const char** files);
 
-char* api_delete(const char* key, size_t filec, const char** files);
+// deletes `files` in batches, like `api_upload_batched`
+size_t api_delete_batched(struct APIClient* client, size_t filec, const char** files, size_t batch_size, size_t connections, void(*callback)(const char** files, size_t filec, const char* response, void* data), void* data);
 
 /* extras */
 
 // for non-supporter accounts, neocities only allows a selection of file formats.
-// returns 1 if `extension` is an allowed file extension, otherwise 0
-int api_is_extension_allowed(const char* extension);
\ No newline at end of file
+// returns 1 if the `length`-character `extension` (without its dot) is an allowed file extension, ignoring case, otherwise 0
+int api_is_extension_allowed(const char* extension, size_t length);
\ No newline at end of file
@@ -0,0 +1,97 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "arena.h"
+
+#define ARENA_BLOCK_SIZE 65536
+#define ARENA_ALIGN (sizeof(max_align_t))
+
+struct ArenaBlock {
+	struct ArenaBlock* next;
+	size_t size;
+	size_t used;
+	max_align_t data[];
+};
+
+struct Arena {
+	struct ArenaBlock* head; // the block currently being allocated from
+	struct ArenaBlock* first;
+	void* last; // the most recent allocation
+};
+
+/* helpers */
+
+size_t arena_align(size_t size) {
+	return (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+}
+
+struct ArenaBlock* arena_block_create(size_t size) {
+	if (size < ARENA_BLOCK_SIZE) size = ARENA_BLOCK_SIZE;
+	struct ArenaBlock* block = malloc(sizeof(struct ArenaBlock) + size);
+	if (!block) return NULL;
+	block->next = NULL;
+	block->size = size;
+	block->used = 0;
+	return block;
+}
+
+/* interface */
+
+struct Arena* arena_create(void) {
+	struct Arena* arena = malloc(sizeof(struct Arena));
+	if (!arena) return NULL;
+	if (!(arena->first = arena->head = arena_block_create(ARENA_BLOCK_SIZE))) {free(arena); return NULL;}
+	arena->last = NULL;
+	return arena;
+}
+
+void* arena_alloc(struct Arena* arena, size_t size) {
+	size = arena_align(size);
+	struct ArenaBlock* block = arena->head;
+	if (block->size - block->used < size) {
+		if (!(block = arena_block_create(size))) return NULL;
+		arena->head->next = block;
+		arena->head = block;
+	}
+	arena->last = (char*)block->data + block->used;
+	block->used += size;
+	return arena->last;
+}
+
+void* arena_realloc(struct Arena* arena, void* ptr, size_t old_size, size_t size) {
+	if (!ptr) return arena_alloc(arena, size);
+	// growing in place
+	struct ArenaBlock* block = arena->head;
+	if (ptr == arena->last) {
+		size_t start = (char*)ptr - (char*)block->data;
+		if (block->size - start >= arena_align(size)) {
+			block->used = start + arena_align(size);
+			return ptr;
+		}
+	}
+	// moving
+	void* resized = arena_alloc(arena, size);
+	if (!resized) return NULL;
+	memcpy(resized, ptr, old_size < size ? old_size : size);
+	return resized;
+}
+
+void arena_clear(struct Arena* arena) {
+	struct ArenaBlock* block = arena->first->next;
+	while (block) {
+		struct ArenaBlock* next = block->next;
+		free(block);
+		block = next;
+	}
+	arena->first->next = NULL;
+	arena->first->used = 0;
+	arena->head = arena->first;
+	arena->last = NULL;
+}
+
+void arena_destroy(struct Arena* arena) {
+	if (!arena) return;
+	arena_clear(arena);
+	free(arena->first);
+	free(arena);
+}
\ No newline at end of file
@@ -0,0 +1,21 @@
+/* arena allocator
+   hands out memory from large blocks, which are all released at once.
+   used for short-lived allocations that would otherwise churn the heap */
+
+struct Arena;
+
+// returns a new empty arena, or null if memory couldn't be allocated
+struct Arena* arena_create(void);
+
+// returns `size` bytes of memory aligned for any type, or null if memory couldn't be allocated
+void* arena_alloc(struct Arena* arena, size_t size);
+
+// resizes the allocation at `ptr` from `old_size` to `size` bytes, keeping its contents
+// grows in place if `ptr` is the arena's most recent allocation and there's room, otherwise copies it
+// returns the resized allocation, or null if memory couldn't be allocated (leaving `ptr` untouched)
+void* arena_realloc(struct Arena* arena, void* ptr, size_t old_size, size_t size);
+
+// releases all allocations, keeping the first block for reuse
+void arena_clear(struct Arena* arena);
+
+void arena_destroy(struct Arena* arena);
\ No newline at end of file
@@ -1,24 +1,82 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 #include <time.h>
-#include <dirent.h>
 #include <sys/stat.h>
 #include <termios.h>
+#include <unistd.h>
 #include "cli.h"
 #include "api.h"
 #include "json.h"
+#include "arena.h"
+#include "sha1.h"
+#include "manifest.h"
+#include "listing.h"
+#include "query.h"
+#include "walk.h"
+#include "pathtable.h"
+#include "ignore.h"
+#include "timing.h"
+#include "watch.h"
 
 #define KEY_SIZE (KEY_LENGTH + 1)
 #define ARRAY_REALLOC_STEP 32
+#define UPLOAD_BATCH_SIZE 16
+#define UPLOAD_CHUNK_SIZE 4096 // paths decoded from a table for each run of upload batches
+#define DELETE_BATCH_SIZE 64
+#define DEFAULT_CONNECTIONS 8
+#define DEFAULT_CACHE_TTL 60
+#define WATCH_DEBOUNCE 100
 #define ERROR_FILE_LIST_EMPTY "couldn't find any files"
 #define ERROR_RESPONSE_FETCH "couldn't fetch response"
 #define ERROR_RESPONSE_PARSE "couldn't parse response"
 
+// remote files (but not directories) from a listing
+struct RemoteFileList {
+	struct RemoteFile* files;
+	size_t count;
+	struct Listing listing; // holds every entry
+};
+
+void remote_files_destroy(struct RemoteFileList* list);
+void file_print(const struct RemoteFile* file, int first);
+
+// global options, given before the command
+struct Options {
+	size_t connections;
+	long cache_ttl;
+	const char* api_url; // null for the neocities api
+	int json; // whether to print newline-delimited json instead of text
+	int supporter; // whether the site has a supporter account, which can upload any file type
+} options = {DEFAULT_CONNECTIONS, DEFAULT_CACHE_TTL, NULL, 0, 0};
+
+// buffered stdout, used for json output
+struct JSONWriter* output = NULL;
+
+// parses a global option. returns 0 on success
+int option_parse(const char* arg) {
+	if (!strncmp(arg, "--connections=", 14) && atoi(arg + 14) > 0) options.connections = atoi(arg + 14);
+	else if (!strncmp(arg, "--cache-ttl=", 12) && atol(arg + 12) >= 0) options.cache_ttl = atol(arg + 12);
+	else if (!strncmp(arg, "--api-url=", 10) && arg[10]) options.api_url = arg + 10;
+	else if (!strcmp(arg, "--timings")) timing_enable(0);
+	else if (!strcmp(arg, "--timings=json")) timing_enable(1);
+	else if (!strcmp(arg, "--json")) options.json = 1;
+	else if (!strcmp(arg, "--supporter")) options.supporter = 1;
+	else return 1;
+	return 0;
+}
+
 int main(int argc, const char** args) {
 	srand(time(NULL));
+	options.api_url = getenv("NEOCAPI_URL");
+	options.supporter = getenv("NEOCAPI_SUPPORTER") && *getenv("NEOCAPI_SUPPORTER");
 	argc--, args++;
+	for (; argc && !strncmp(*args, "--", 2); argc--, args++)
+		if (option_parse(*args)) {print_error("unrecognized option: %s", *args); return 1;}
+	if (options.json && !(output = json_writer_create(STDOUT_FILENO))) {print_error(ERROR_ALLOCATION); return 1;}
 	if (!argc) cmd_help(0, NULL);
 	else {
 		void(*command)(size_t, const char**) = NULL;
@@ -28,9 +86,14 @@ int main(int argc, const char** args) {
 		else if (!strcmp(*args, "upload")) command = cmd_upload;
 		else if (!strcmp(*args, "delete")) command = cmd_delete;
 		else if (!strcmp(*args, "diff")) command = cmd_diff;
+		else if (!strcmp(*args, "sync")) command = cmd_sync;
+		else if (!strcmp(*args, "prune")) command = cmd_prune;
+		else if (!strcmp(*args, "watch")) command = cmd_watch;
 		else {print_error("unrecognized command: %s", *args); return 1;}
 		command(argc - 1, args + 1);
 	}
+	if (output && json_writer_destroy(output)) print_error("couldn't write output");
+	timing_report();
 	return 0;
 }
 
@@ -52,6 +115,14 @@ void get_key(char key[KEY_SIZE]) {
 	printf("\n");
 }
 
+// creates an api client with the user's key
+// returns null on failure
+struct APIClient* client_create(void) {
+	char key[KEY_SIZE] = {0};
+	get_key(key);
+	return api_client_create(key, options.api_url);
+}
+
 int response_successful(struct JSONIndex* index) {
 	const char* result = json_index_pair(index, "result");
 	return result && !strncmp(result, "\"success\"", 9);
@@ -73,75 +144,302 @@ int array_add(void** array_p, size_t size, size_t unit, const void* value_p) {
 	return 0;
 }
 
-void paths_destroy(char** paths, size_t size) {
-	for (size_t i = 0; i < size; i++) free(paths[i]);
-	free(paths);
-}
+// tracks progress across upload or delete batches
+struct BatchProgress {
+	size_t done;
+	size_t total;
+	size_t failed;
+	struct Listing* listing; // records uploaded or deleted files. may be null
+	int listing_stale; // whether an uploaded file couldn't be recorded
+};
 
-size_t paths_add(char*** paths_p, size_t size, const char* path) {
-	if (*path == '.' && path[1] == '/' && path[2]) path += 2;
-	struct stat statbuf;
-	if (stat(path, &statbuf)) print_error("couldn't find file: %s", path);
-	// dir
-	else if (S_ISDIR(statbuf.st_mode)) {
-		DIR* dir = opendir(path);
-		if (!dir) print_error("couldn't open directory: %s", path);
-		else {
-			struct dirent* entry;
-			while ((entry = readdir(dir))) {
-				if (*entry->d_name == '.') continue;
-				char* entry_path = malloc(strlen(path) + strlen(entry->d_name) + 2);
-				if (!entry_path) continue;
-				strcpy(entry_path, path);
-				if (path[strlen(path) - 1] != '/') strcat(entry_path, "/");
-				strcat(entry_path, entry->d_name);
-				size = paths_add(paths_p, size, entry_path);
-				free(entry_path);
-				if (!*paths_p) break;
-			}
-			closedir(dir);
+// prints the result of one upload batch. used as an `api_upload_batched` callback
+void upload_batch_print(const char** files, size_t filec, const char* response, void* data) {
+	struct BatchProgress* progress = data;
+	progress->done += filec;
+	struct JSONIndex* index = response ? json_index_object(response, NULL) : NULL;
+	if (index && response_successful(index)) {
+		print_success("%d/%d files uploaded", progress->done, progress->total);
+		if (progress->listing) for (size_t i = 0; i < filec; i++) {
+			struct stat statbuf;
+			unsigned char sha1[SHA1_LENGTH];
+			if (stat(files[i], &statbuf) || sha1_file(files[i], sha1) || listing_upload(progress->listing, files[i], statbuf.st_size, time(NULL), sha1))
+				progress->listing_stale = 1;
 		}
 	}
-	// file
 	else {
-		char* ext = strrchr(path, '.');
-		if (!ext) print_error("missing file extension: %s", path);
-		else if (!api_is_extension_allowed(ext + 1)) print_error("forbidden file extension: %s", path);
-		else {
-			path = strdup(path);
-			array_add((void*)paths_p, size, sizeof(char*), &path);
-			if (!*paths_p) paths_destroy(*paths_p, size);
-			else size++;
+		progress->failed += filec;
+		if (index) response_print_message(index, print_error);
+		print_error("couldn't upload %d files:", filec);
+		for (size_t i = 0; i < filec; i++) printf("    %s\n", files[i]);
+	}
+	free(index);
+}
+
+// saves `listing` after the uploads counted in `progress`, or removes the cache if they couldn't all be recorded
+// returns the number of files that failed to upload
+size_t upload_finish(struct BatchProgress* progress, struct Listing* listing) {
+	if (progress->listing_stale) remove(LISTING_PATH);
+	else if (listing && listing_save(listing, LISTING_PATH)) print_error("couldn't save %s", LISTING_PATH);
+	return progress->failed + progress->total - progress->done;
+}
+
+// uploads `paths` in concurrent batches, printing each batch's result
+// records uploaded files in `listing` (which may be null) and saves it, or removes the cache if they couldn't be recorded
+// returns the number of files that failed to upload
+size_t upload_files(struct APIClient* client, size_t pathc, const char** paths, struct Listing* listing) {
+	struct BatchProgress progress = {0, pathc, 0, listing, 0};
+	api_upload_batched(client, pathc, paths, UPLOAD_BATCH_SIZE, options.connections, upload_batch_print, &progress);
+	return upload_finish(&progress, listing);
+}
+
+// uploads every path in `table` like `upload_files`, decoding a chunk of paths at a time so they're never all whole at once
+size_t upload_table(struct APIClient* client, const struct PathTable* table, struct Listing* listing) {
+	struct BatchProgress progress = {0, table->count, 0, listing, 0};
+	struct PathList chunk;
+	if (path_list_create(&chunk)) {print_error(ERROR_ALLOCATION); return table->count;}
+	char buffer[table->max_length + 1];
+	struct PathCursor cursor;
+	path_cursor_start(&cursor, table, 0, buffer);
+	const char* path;
+	int error = 0;
+	while (!error && cursor.index < table->count) {
+		chunk.count = 0;
+		arena_clear(chunk.arena);
+		while (!error && chunk.count < UPLOAD_CHUNK_SIZE && (path = path_cursor_next(&cursor)))
+			error = path_list_add(&chunk, path, strlen(path));
+		if (error) print_error(ERROR_ALLOCATION);
+		else api_upload_batched(client, chunk.count, (const char**)chunk.paths, UPLOAD_BATCH_SIZE, options.connections, upload_batch_print, &progress);
+	}
+	path_list_destroy(&chunk);
+	return upload_finish(&progress, listing);
+}
+
+// prints the result of one delete batch. used as an `api_delete_batched` callback
+void delete_batch_print(const char** files, size_t filec, const char* response, void* data) {
+	struct BatchProgress* progress = data;
+	progress->done += filec;
+	struct JSONIndex* index = response ? json_index_object(response, NULL) : NULL;
+	if (index && response_successful(index)) {
+		print_success("%d/%d files deleted", progress->done, progress->total);
+		if (progress->listing) for (size_t i = 0; i < filec; i++) listing_delete(progress->listing, files[i]);
+	}
+	else {
+		progress->failed += filec;
+		if (index) response_print_message(index, print_error);
+		print_error("couldn't delete %d files:", filec);
+		for (size_t i = 0; i < filec; i++) printf("    %s\n", files[i]);
+	}
+	free(index);
+}
+
+// deletes `paths` in concurrent batches, printing each batch's result
+// removes deleted files from `listing` (which may be null) and saves it
+// returns the number of files that failed to delete
+size_t delete_files(struct APIClient* client, size_t pathc, const char** paths, struct Listing* listing) {
+	struct BatchProgress progress = {0, pathc, 0, listing, 0};
+	api_delete_batched(client, pathc, paths, DELETE_BATCH_SIZE, options.connections, delete_batch_print, &progress);
+	if (listing && listing_save(listing, LISTING_PATH)) print_error("couldn't save %s", LISTING_PATH);
+	return progress.failed + progress.total - progress.done;
+}
+
+// loads the site's ignore rules
+// returns null on failure, after printing an error
+struct Ignore* ignore_rules_load(void) {
+	struct Ignore* ignore = ignore_create();
+	if (!ignore || ignore_load(ignore, IGNORE_PATH)) {
+		print_error(ERROR_ALLOCATION);
+		ignore_destroy(ignore);
+		return NULL;
+	}
+	return ignore;
+}
+
+// adds the files at `path` to `paths`, skipping any that are ignored or have a missing or forbidden extension
+// extensions aren't checked for supporter accounts
+// returns 0 on success, or 1 if memory couldn't be allocated
+int paths_add(struct PathList* paths, const char* path, const struct Ignore* ignore) {
+	size_t start = paths->count;
+	if (walk_paths(paths, path, ignore)) return 1;
+	if (options.supporter) return 0;
+	size_t kept = start;
+	for (size_t i = start; i < paths->count; i++) {
+		// finding the extension of the file's name, not of a directory it's in
+		const char* ext = NULL;
+		const char* end = paths->paths[i];
+		for (; *end; end++) {
+			if (*end == '.') ext = end + 1;
+			else if (*end == '/') ext = NULL;
 		}
+		if (!ext) print_error("missing file extension: %s", paths->paths[i]);
+		else if (!api_is_extension_allowed(ext, end - ext)) print_error("forbidden file extension: %s", paths->paths[i]);
+		else paths->paths[kept++] = paths->paths[i];
 	}
-	return size;
+	paths->count = kept;
+	return 0;
 }
 
+// fills `table` with the files at each of `paths`, like `paths_add`. there's nothing to destroy on failure
+// returns 0 on success, or 1 if memory couldn't be allocated
+int paths_load(struct PathTable* table, size_t pathc, const char** paths, const struct Ignore* ignore) {
+	struct PathList list;
+	if (path_list_create(&list)) return 1;
+	int error = 0;
+	for (size_t i = 0; i < pathc && !error; i++) error = paths_add(&list, paths[i], ignore);
+	error = error || path_table_create(table, &list);
+	path_list_destroy(&list);
+	return error;
+}
+
+// reads a date like "Sat, 13 Feb 2016 03:04:00 -0000", as neocities gives them
 time_t string_to_time(const char* string) {
-	struct tm time;
+	const char* months = "JanFebMarAprMayJunJulAugSepOctNovDec";
+	struct tm time = {0};
 	time.tm_mday = atoi(string += 5);
-	switch (*(string += 3)) {
-		case 'M': time.tm_mon = string[2] == 'r' ? 3 : 5;
-		case 'A': time.tm_mon = string[1] == 'p' ? 4 : 7;
-		case 'J': time.tm_mon = 5 + string[2] == 'l';
-		case 'F': time.tm_mon = 2;
-		case 'S': time.tm_mon = 8;
-		case 'O': time.tm_mon = 9;
-		case 'N': time.tm_mon = 10;
-		case 'D': time.tm_mon = 11;
-		default: time.tm_mon = 0;
-	}
-	time.tm_year = atoi(string += 4) - 1990;
+	for (time.tm_mon = 0; time.tm_mon < 11 && strncmp(months + time.tm_mon * 3, string + 3, 3); time.tm_mon++);
+	time.tm_year = atoi(string += 7) - 1900;
 	time.tm_hour = atoi(string += 5);
 	time.tm_min = atoi(string += 3);
 	time.tm_sec = atoi(string += 3);
-	return mktime(&time);
+	return timegm(&time);
 }
 
 int string_sort(const void* a, const void* b) {
 	return strcmp(*(const char**)a, *(const char**)b);
 }
 
+// decodes the date string at `json` into a `time_t`. used as a `BIND_CUSTOM` parse function
+int time_parse(const char* json, void* time_p) {
+	if (json_type(json) != JSON_STRING) return 1;
+	*(time_t*)time_p = string_to_time(json + 1);
+	return 0;
+}
+
+// decodes the hex hash string at `json` into a sha1. used as a `BIND_CUSTOM` parse function
+int sha1_parse(const char* json, void* hash) {
+	return json_type(json) != JSON_STRING || json_string_length(json) != SHA1_LENGTH * 2 || sha1_from_hex(json + 1, hash);
+}
+
+// fields bound from each file entry in a list response
+enum {REMOTE_FIELD_PATH, REMOTE_FIELD_CREATED, REMOTE_FIELD_TIME, REMOTE_FIELD_SIZE, REMOTE_FIELD_DIRECTORY, REMOTE_FIELD_SHA1};
+const struct JSONField remote_file_fields[] = {
+	[REMOTE_FIELD_PATH] = {"path", BIND_STRING, offsetof(struct RemoteFile, path)},
+	[REMOTE_FIELD_CREATED] = {"created_at", BIND_CUSTOM, offsetof(struct RemoteFile, created), time_parse},
+	[REMOTE_FIELD_TIME] = {"updated_at", BIND_CUSTOM, offsetof(struct RemoteFile, time), time_parse},
+	[REMOTE_FIELD_SIZE] = {"size", BIND_INT, offsetof(struct RemoteFile, size)},
+	[REMOTE_FIELD_DIRECTORY] = {"is_directory", BIND_BOOL, offsetof(struct RemoteFile, is_directory)},
+	[REMOTE_FIELD_SHA1] = {"sha1_hash", BIND_CUSTOM, offsetof(struct RemoteFile, sha1), sha1_parse},
+};
+
+// state for collecting a streamed listing
+struct ListingCollector {
+	struct Listing* listing;
+	int print; // whether to print each entry as it arrives
+	int error;
+};
+
+// adds a file entry to a listing. used as an `api_list_stream` callback
+int remote_file_collect(const char* json, void* data) {
+	struct ListingCollector* collector = data;
+	struct RemoteFile remote = {0};
+	unsigned long found;
+	if (json_bind(json, remote_file_fields, sizeof(remote_file_fields) / sizeof(*remote_file_fields), &remote, collector->listing->arena, &found)) {collector->error = 1; return 1;}
+	if (!(found & 1 << REMOTE_FIELD_PATH)) return 0;
+	remote.has_sha1 = !!(found & 1 << REMOTE_FIELD_SHA1);
+	if (listing_add(collector->listing, &remote)) {collector->error = 1; return 1;}
+	if (collector->print) file_print(&remote, collector->listing->count == 1);
+	return 0;
+}
+
+// fetches the listing of `directory` (which may be null) into an empty `listing`, parsing it as it arrives
+// a listing of the whole site is cached
+// returns 0 on success, or 1 on failure, after printing an error
+int remote_listing_fetch(struct APIClient* client, const char* directory, struct Listing* listing, int print) {
+	struct ListingCollector collector = {listing, print, 0};
+	char* response = api_list_stream(client, directory, remote_file_collect, &collector);
+	struct JSONIndex* index = NULL;
+	int error = 1;
+	if (collector.error) print_error(ERROR_ALLOCATION);
+	else if (!response) print_error(ERROR_RESPONSE_FETCH);
+	else if (!(index = json_index_object(response, NULL))) print_error(ERROR_ALLOCATION);
+	else if (!response_successful(index)) response_print_message(index, print_error);
+	else error = 0;
+	free(index);
+	if (error || directory) return error;
+	listing->fetched = time(NULL);
+	listing->dirty = 1;
+	if (listing_save(listing, LISTING_PATH)) print_error("couldn't save %s", LISTING_PATH);
+	return 0;
+}
+
+// gets all remote files (but not directories or files excluded by `ignore`) into `list`, sorted by path
+// the cached listing is used if it hasn't expired, otherwise the listing is fetched
+// returns 0 on success. on failure, prints an error and leaves nothing to destroy
+int remote_files_fetch(struct APIClient* client, const struct Ignore* ignore, struct RemoteFileList* list) {
+	list->files = NULL;
+	list->count = 0;
+	if (listing_create(&list->listing)) {print_error(ERROR_ALLOCATION); return 1;}
+	if (listing_load(&list->listing, LISTING_PATH, options.cache_ttl) && remote_listing_fetch(client, NULL, &list->listing, 0)) goto cleanup_listing;
+	listing_sort(&list->listing);
+	// picking out files
+	list->files = malloc((list->listing.count ? list->listing.count : 1) * sizeof(struct RemoteFile));
+	if (!list->files) {print_error(ERROR_ALLOCATION); goto cleanup_listing;}
+	for (size_t i = 0; i < list->listing.count; i++) {
+		const struct RemoteFile* file = &list->listing.files[i];
+		if (!file->is_directory && !ignore_match(ignore, file->path, 0)) list->files[list->count++] = *file;
+	}
+	return 0;
+	cleanup_listing: listing_destroy(&list->listing);
+	return 1;
+}
+
+void remote_files_destroy(struct RemoteFileList* list) {
+	free(list->files);
+	listing_destroy(&list->listing);
+}
+
+// compares the next entries in a merge join of sorted local paths and remote files
+// returns <0 if the local path comes first, >0 if the remote file comes first, or 0 if they match
+// an exhausted side (a null `local` path) always compares after the other
+int join_compare(const char* local, const struct RemoteFile* remote, size_t remote_idx, size_t remote_count) {
+	if (!local) return 1;
+	if (remote_idx == remote_count) return -1;
+	return strcmp(local, remote[remote_idx].path);
+}
+
+// returns 1 if the local file at `path` has the same contents as `remote`, based on their sha1 hashes
+// local hashes are cached in `manifest`
+int file_matches_remote(struct Manifest* manifest, const char* path, const struct stat* statbuf, const struct RemoteFile* remote) {
+	unsigned char sha1[SHA1_LENGTH];
+	return remote->has_sha1 && !manifest_hash(manifest, path, statbuf, sha1) && !memcmp(sha1, remote->sha1, SHA1_LENGTH);
+}
+
+// hashes every local path that has a matching remote file up front, so the files are read in parallel
+// if `local` has times, files whose times match the remote ones are skipped, as they won't be compared
+// returns 1 if memory couldn't be allocated
+int join_refresh(struct Manifest* manifest, const struct PathTable* local, const struct RemoteFileList* remote) {
+	struct PathList matches;
+	if (path_list_create(&matches)) return 1;
+	char buffer[local->max_length + 1];
+	struct PathCursor cursor;
+	path_cursor_start(&cursor, local, 0, buffer);
+	const char* path = path_cursor_next(&cursor);
+	size_t remote_idx = 0;
+	int error = 0;
+	while (!error && path && remote_idx < remote->count) {
+		int cmp = join_compare(path, remote->files, remote_idx, remote->count);
+		if (cmp > 0) {remote_idx++; continue;}
+		if (!cmp) {
+			if (!local->times || difftime(remote->files[remote_idx].time, local->times[cursor.index - 1])) error = path_list_add(&matches, path, strlen(path));
+			remote_idx++;
+		}
+		path = path_cursor_next(&cursor);
+	}
+	error = error || manifest_refresh(manifest, matches.count, (const char**)matches.paths);
+	path_list_destroy(&matches);
+	return error;
+}
+
 /* commands */
 
 void cmd_help(size_t argc, const char** args) {
@@ -156,7 +454,21 @@ void cmd_help(size_t argc, const char** args) {
 	"    \e[32mupload\e[0m [paths]   upload files to site\n"
 	"    \e[32mdelete\e[0m [paths]   delete files from site\n"
 	"    \e[32mdiff\e[0m             list changes\n"
+	"    \e[32msync\e[0m             upload changed files\n"
+	"    \e[32mprune\e[0m            delete files missing locally\n"
+	"    \e[32mwatch\e[0m            upload + delete files as they change\n"
 	"    \e[32mhelp\e[0m [command]   display documentation\n\n"
+	"  options go before the command:\n"
+	"    \e[32m--connections=\e[0m[n]  max concurrent requests (default %d)\n"
+	"    \e[32m--cache-ttl=\e[0m[s]    reuse the site listing for [s] seconds\n"
+	"                        (default %d, 0 to always fetch)\n"
+	"    \e[32m--api-url=\e[0m[url]    send requests to another api server\n"
+	"                        (default %s)\n"
+	"    \e[32m--timings\e[0m[=json]   report time spent in each phase + request\n"
+	"    \e[32m--json\e[0m              print info, list, and diff output as\n"
+	"                        newline-delimited json\n"
+	"    \e[32m--supporter\e[0m         upload files of any type, for supporter\n"
+	"                        accounts\n\n", DEFAULT_CONNECTIONS, DEFAULT_CACHE_TTL, API_DEFAULT_URL
 	);
 	else if (!strcmp(*args, "info")) printf(
 	"    \e[32minfo\e[0m [sitename]\n"
@@ -167,53 +479,166 @@ void cmd_help(size_t argc, const char** args) {
 	"    to display its associated site.\n\n"
 	);
 	else if (!strcmp(*args, "list")) printf(
-	"    \e[32mlist\e[0m [path]\n"
+	"    \e[32mlist\e[0m [path] [query]\n"
 	"    lists all remote files.\n"
 	"      if [path] is present, lists only the contents\n"
-	"    of the remote directory at [path].\n\n"
+	"    of the remote directory at [path].\n"
+	"      [query] is answered from the full listing,\n"
+	"    with any of these terms, separated by spaces:\n"
+	"      \e[32mfiles\e[0m, \e[32mdirs\e[0m         only that kind of entry\n"
+	"      \e[32msize\e[0m>10m, \e[32mfiles\e[0m<=5,   compare a field with\n"
+	"      \e[32mupdated\e[0m<2024-01-31, <, <=, =, >= or >. sizes\n"
+	"      \e[32mcreated\e[0m>=...       take k/m/g, dates are\n"
+	"                          yyyy-mm-dd[thh:mm:ss]\n"
+	"      \e[32mname\e[0m=[glob]         match entry names\n"
+	"      \e[32mdepth\e[0m=[n]           at most [n] levels down\n"
+	"      \e[32msort\e[0m=[-][field]     by path, size, files,\n"
+	"                          updated or created.\n"
+	"                          - sorts descending\n"
+	"      \e[32mlimit\e[0m=[n]           only the first [n]\n"
+	"      \e[32mdu\e[0m                  total the files beneath\n"
+	"                          [path] + each directory\n"
+	"    a directory's size, files + updated time are\n"
+	"    totals of the files beneath it. end [path]\n"
+	"    with / if it looks like a term.\n"
+	"      the full listing is cached for a while, and\n"
+	"    reused by list, diff, and sync. set how long\n"
+	"    with --cache-ttl=[s].\n\n"
 	);
 	else if (!strcmp(*args, "upload")) printf(
 	"    \e[32mupload\e[0m [paths]\n"
 	"    recursively uploads local files to the remote\n"
 	"    root. separate multiple paths with spaces;\n"
 	"    exclude paths by prefixing them with '-'.\n"
-	"      if [paths] is absent, uploads all local files.\n\n"
+	"      if [paths] is absent, uploads all local files.\n"
+	"      paths matching the rules in .neocignore are\n"
+	"    skipped. see \e[32mhelp ignore\e[0m.\n"
+	"      files are sent in batches, several at once.\n"
+	"    set how many with --connections=[n].\n\n"
 	);
 	else if (!strcmp(*args, "delete")) printf(
 	"    \e[32mdelete\e[0m [paths]\n"
 	"    deletes remote files. separate multiple paths\n"
-	"    with spaces.\n\n"
+	"    with spaces. files are deleted in concurrent\n"
+	"    batches.\n\n"
 	);
 	else if (!strcmp(*args, "diff")) printf(
-	"    \e[32mdiff\e[0m\n"
+	"    \e[32mdiff\e[0m [--stream]\n"
 	"    lists differences between local and remote\n"
-	"    files, based on their paths and update times.\n\n"
+	"    files, based on their paths and update times.\n"
+	"    files with matching contents are unchanged.\n"
+	"      paths matching .neocignore are left out.\n"
+	"      with --stream, changes are listed as the\n"
+	"    remote listing arrives, without keeping it.\n"
+	"    the listing isn't cached, and must arrive\n"
+	"    sorted by path.\n\n"
+	);
+	else if (!strcmp(*args, "sync")) printf(
+	"    \e[32msync\e[0m\n"
+	"    uploads local files that are new or whose\n"
+	"    contents differ from their remote copies,\n"
+	"    based on their sha1 hashes.\n\n"
+	);
+	else if (!strcmp(*args, "prune")) printf(
+	"    \e[32mprune\e[0m\n"
+	"    deletes remote files that don't exist locally,\n"
+	"    after confirming. ignored files are left alone.\n\n"
+	);
+	else if (!strcmp(*args, "watch")) printf(
+	"    \e[32mwatch\e[0m\n"
+	"    uploads files as they're saved, and deletes\n"
+	"    remote files as local ones are removed, until\n"
+	"    stopped. ignored files are left alone.\n"
+	"    linux only.\n\n"
 	);
 	else if (!strcmp(*args, "help")) printf(
 	"    \e[32mhelp\e[0m [command]\n"
 	"    prints documentation about a command.\n"
 	"      if [command] is absent, lists all commands.\n\n"
 	);
+	else if (!strcmp(*args, "ignore")) printf(
+	"    \e[32m.neocignore\e[0m\n"
+	"    lists local paths to leave out of upload, diff,\n"
+	"    and sync, one glob per line, like .gitignore.\n"
+	"      '*' matches within a name, and '**' matches\n"
+	"    any number of directories. a leading '!' brings\n"
+	"    back paths excluded by earlier lines, and a\n"
+	"    trailing '/' only matches directories.\n"
+	"      ignored directories are never searched.\n\n"
+	);
 	else print_error("no documentation for: %s\n", *args);
 }
 
 /* api commands */
 
+// writes site info as one json object, with dates as given and a domain even if the site has none
+void info_write(struct JSONIndex* info, struct Arena* arena) {
+	const char* buf;
+	const char* sitename = json_index_pair(info, "sitename");
+	if (sitename && json_type(sitename) != JSON_STRING) sitename = NULL;
+	json_writer_open(output, '{');
+	if (sitename) {
+		json_writer_key(output, "sitename");
+		json_writer_escaped(output, sitename + 1, json_string_length(sitename));
+	}
+	if ((buf = json_index_pair(info, "domain")) && json_type(buf) == JSON_STRING) {
+		json_writer_key(output, "domain");
+		json_writer_escaped(output, buf + 1, json_string_length(buf));
+	} else if (sitename) {
+		size_t length = json_string_length(sitename);
+		char domain[length + 15];
+		sprintf(domain, "%.*s.neocities.org", (unsigned)length, sitename + 1);
+		json_writer_key(output, "domain");
+		json_writer_escaped(output, domain, strlen(domain));
+	}
+	if ((buf = json_index_pair(info, "tags")) && json_type(buf) == JSON_ARRAY) {
+		struct JSONIndex* tags = json_index_array(buf, arena);
+		if (!tags) print_error(ERROR_ALLOCATION);
+		else {
+			json_writer_key(output, "tags");
+			json_writer_open(output, '[');
+			for (size_t i = 0; i < json_index_size(tags); i++)
+				if ((buf = json_index_item(tags, i)) && json_type(buf) == JSON_STRING)
+					json_writer_escaped(output, buf + 1, json_string_length(buf));
+			json_writer_close(output, ']');
+		}
+	}
+	const char* strings[] = {"created_at", "last_updated"};
+	for (size_t i = 0; i < sizeof(strings) / sizeof(*strings); i++)
+		if ((buf = json_index_pair(info, strings[i])) && json_type(buf) == JSON_STRING) {
+			json_writer_key(output, strings[i]);
+			json_writer_escaped(output, buf + 1, json_string_length(buf));
+		}
+	const char* ints[] = {"views", "hits"};
+	for (size_t i = 0; i < sizeof(ints) / sizeof(*ints); i++)
+		if ((buf = json_index_pair(info, ints[i])) && json_type(buf) == JSON_INT) {
+			json_writer_key(output, ints[i]);
+			json_writer_int(output, strtoll(buf, NULL, 10));
+		}
+	json_writer_close(output, '}');
+	json_writer_newline(output);
+}
+
 void cmd_info(size_t argc, const char** args) {
 	// fetching info
 	print_loading("directing spies");
-	char key[KEY_SIZE];
-	get_key(key);
-	char* response = argc ? api_info(NULL, *args) : api_info(key, NULL);
-	if (!response) {print_error(ERROR_RESPONSE_FETCH); return;}
+	timing_phase("fetch");
+	struct APIClient* client = argc ? api_client_create(NULL, options.api_url) : client_create();
+	if (!client) return;
+	char* response = api_info(client, argc ? *args : NULL);
+	if (!response) {print_error(ERROR_RESPONSE_FETCH); goto cleanup_client;}
 	// parsing response
-	struct JSONIndex* index = json_index_object(response);
-	if (!index) {print_error(ERROR_ALLOCATION); goto cleanup_response;}
-	if (!response_successful(index)) {response_print_message(index, print_error); goto cleanup_response;}
+	struct Arena* arena = arena_create();
+	if (!arena) {print_error(ERROR_ALLOCATION); goto cleanup_client;}
+	struct JSONIndex* index = json_index_object(response, arena);
+	if (!index) {print_error(ERROR_ALLOCATION); goto cleanup_arena;}
+	if (!response_successful(index)) {response_print_message(index, print_error); goto cleanup_arena;}
 	// printing info
-	struct JSONIndex* info = json_index_object(json_index_pair(index, "info"));
-	if (!info) {print_error(ERROR_ALLOCATION); goto cleanup_response;}
-	const char* buf;
+	timing_phase("print");
+	const char* buf = json_index_pair(index, "info");
+	struct JSONIndex* info = buf && json_type(buf) == JSON_OBJECT ? json_index_object(buf, arena) : NULL;
+	if (!info) {print_error(ERROR_RESPONSE_PARSE); goto cleanup_arena;}
+	if (output) {info_write(info, arena); goto cleanup_arena;}
 	const char* sitename = NULL;
 	printf("\n");
 	if ((buf = json_index_pair(info, "sitename")) && json_type(buf) == JSON_STRING) {
@@ -225,7 +650,7 @@ void cmd_info(size_t argc, const char** args) {
 	else if (sitename)
 		printf("    \e[32mdomain\e[0m   %.*s.neocities.org\n", (unsigned)json_string_length(sitename), sitename + 1);
 	if ((buf = json_index_pair(info, "tags")) && json_type(buf) == JSON_ARRAY) {
-		struct JSONIndex* tags = json_index_array(buf);
+		struct JSONIndex* tags = json_index_array(buf, arena);
 		if (!tags) print_error(ERROR_ALLOCATION);
 		else {
 			printf("    \e[32mtags\e[0m     ");
@@ -235,7 +660,6 @@ void cmd_info(size_t argc, const char** args) {
 					printf("%.*s", (unsigned)json_string_length(buf), buf + 1);
 				}
 			printf("\n");
-			free(tags);
 		}
 	}
 	if ((buf = json_index_pair(info, "created_at")) && json_type(buf) == JSON_STRING)
@@ -247,98 +671,183 @@ void cmd_info(size_t argc, const char** args) {
 	if ((buf = json_index_pair(info, "hits")) && json_type(buf) == JSON_INT)
 		printf("    \e[32mhits\e[0m     %d\n", atoi(buf));
 	printf("\n");
-	free(info);
 	// cleanup
-	cleanup_response: free(index); free(response);
+	cleanup_arena: arena_destroy(arena);
+	cleanup_client: api_client_destroy(client);
+}
+
+// writes a file entry from a listing as one json object, with dates in unix time
+void file_write(const struct RemoteFile* file) {
+	json_writer_open(output, '{');
+	json_writer_key(output, "path");
+	json_writer_escaped(output, file->path, strlen(file->path));
+	json_writer_key(output, "is_directory");
+	json_writer_bool(output, file->is_directory);
+	if (!file->is_directory) {
+		json_writer_key(output, "size");
+		json_writer_int(output, file->size);
+	}
+	if (file->created) {
+		json_writer_key(output, "created_at");
+		json_writer_int(output, file->created);
+	}
+	if (file->time) {
+		json_writer_key(output, "updated_at");
+		json_writer_int(output, file->time);
+	}
+	if (file->has_sha1) {
+		char hex[SHA1_LENGTH * 2 + 1];
+		for (int i = 0; i < SHA1_LENGTH; i++) sprintf(hex + i * 2, "%02x", file->sha1[i]);
+		json_writer_key(output, "sha1_hash");
+		json_writer_escaped(output, hex, SHA1_LENGTH * 2);
+	}
+	json_writer_close(output, '}');
+	json_writer_newline(output);
+}
+
+// prints a date as neocities gives them
+void time_print(const char* label, time_t time) {
+	char string[32];
+	strftime(string, sizeof(string), "%a, %d %b %Y %H:%M:%S -0000", gmtime(&time));
+	printf("    \e[32m%s\e[0m%*s%s\n", label, (int)(9 - strlen(label)), "", string);
+}
+
+// prints a file entry from a listing, after a blank line if it's the `first`
+void file_print(const struct RemoteFile* file, int first) {
+	if (output) {file_write(file); return;}
+	if (first) printf("\n");
+	printf("    %s%s\n", file->path, file->is_directory ? "/" : "");
+	if (!file->is_directory)
+		printf("    \e[32msize\e[0m     %lld bytes\n", (long long)file->size);
+	if (file->created) time_print("created", file->created);
+	if (file->time) time_print("updated", file->time);
+	if (file->has_sha1) {
+		printf("    \e[32msha1\e[0m     ");
+		for (int i = 0; i < SHA1_LENGTH; i++) printf("%02x", file->sha1[i]);
+		printf("\n");
+	}
+	printf("\n");
+}
+
+// prints the du total of `result`, which is the `length`-character `path` if it isn't in the listing, after a blank line if it's the `first`
+void total_print(const struct QueryResult* result, const char* path, size_t length, int first) {
+	if (output) {
+		json_writer_open(output, '{');
+		json_writer_key(output, "path");
+		if (result->file) json_writer_escaped(output, result->file->path, strlen(result->file->path));
+		else json_writer_string(output, path, length);
+		json_writer_key(output, "size");
+		json_writer_int(output, result->size);
+		json_writer_key(output, "files");
+		json_writer_int(output, result->count);
+		if (result->updated) {
+			json_writer_key(output, "updated_at");
+			json_writer_int(output, result->updated);
+		}
+		json_writer_close(output, '}');
+		json_writer_newline(output);
+		return;
+	}
+	if (first) printf("\n");
+	if (result->file) printf("    %s%s\n", result->file->path, result->file->is_directory ? "/" : "");
+	else printf("    %.*s/\n", (int)length, path);
+	printf("    \e[32msize\e[0m     %lld bytes\n", result->size);
+	printf("    \e[32mfiles\e[0m    %lld\n", result->count);
+	if (result->updated) time_print("updated", result->updated);
+	printf("\n");
 }
 
 void cmd_list(size_t argc, const char** args) {
-	// fetching file list
+	struct Query query;
+	const char* term = query_parse(&query, argc, args);
+	if (term) {print_error("unrecognized query term: %s", term); return;}
 	print_loading("conducting census");
-	char key[KEY_SIZE];
-	get_key(key);
-	char* response = api_list(key, argc ? *args : NULL);
-	if (!response) {print_error(ERROR_RESPONSE_FETCH); return;}
-	// parsing response
-	struct JSONIndex* index = json_index_object(response);
-	if (!index) {print_error(ERROR_ALLOCATION); goto cleanup_response;}
-	else if (!response_successful(index)) {response_print_message(index, print_error); goto cleanup_response;}
-	// printing files
-	struct JSONIndex* files = json_index_array(json_index_pair(index, "files"));
-	if (!files) {print_error(ERROR_ALLOCATION); goto cleanup_response;}
-	const char* buf;
-	printf("\n");
-	for (size_t i = 0; i < json_index_size(files); i++) {
-		struct JSONIndex* file = json_index_object(json_index_item(files, i));
-		if (!file) {print_error(ERROR_ALLOCATION); break;}
-		if ((buf = json_index_pair(file, "path")) && json_type(buf) == JSON_STRING)
-			printf("    %.*s", (unsigned)json_string_length(buf), buf + 1);
-		if ((buf = json_index_pair(file, "is_directory")) && json_type(buf) == JSON_BOOL && json_bool(buf))
-			printf("/\n");
-		else
-			printf("\n");
-		if ((buf = json_index_pair(file, "size")) && json_type(buf) == JSON_INT)
-			printf("    \e[32msize\e[0m     %d bytes\n", atoi(buf));
-		if ((buf = json_index_pair(file, "created_at")) && json_type(buf) == JSON_STRING)
-			printf("    \e[32mcreated\e[0m  %.*s\n", (unsigned)json_string_length(buf), buf + 1);
-		if ((buf = json_index_pair(file, "updated_at")) && json_type(buf) == JSON_STRING)
-			printf("    \e[32mupdated\e[0m  %.*s\n", (unsigned)json_string_length(buf), buf + 1);
-		if ((buf = json_index_pair(file, "sha1_hash")) && json_type(buf) == JSON_STRING)
-			printf("    \e[32msha1\e[0m     %.*s\n", (unsigned)json_string_length(buf), buf + 1);
-		printf("\n");
-		free(file);
+	timing_phase("listing");
+	struct Listing listing;
+	if (listing_create(&listing)) {print_error(ERROR_ALLOCATION); return;}
+	struct APIClient* client = NULL;
+	// answering queries locally, from the whole listing
+	if (query.terms) {
+		if (listing_load(&listing, LISTING_PATH, options.cache_ttl) && (!(client = client_create()) || remote_listing_fetch(client, NULL, &listing, 0)))
+			goto cleanup_client;
+		timing_phase("query");
+		listing_sort(&listing);
+		struct QueryResult* results;
+		size_t count;
+		if (query_run(&query, &listing, &results, &count)) {print_error(ERROR_ALLOCATION); goto cleanup_client;}
+		timing_phase("print");
+		for (size_t i = 0; i < count; i++) {
+			if (query.du) total_print(&results[i], query.path, query.path_length, !i);
+			else file_print(results[i].file, !i);
+		}
+		if (!count && !output) printf("\n");
+		free(results);
+		goto cleanup_client;
+	}
+	// printing the cached listing
+	if (!argc && !listing_load(&listing, LISTING_PATH, options.cache_ttl)) {
+		for (size_t i = 0; i < listing.count; i++) file_print(&listing.files[i], !i);
+		if (!listing.count && !output) printf("\n");
+		goto cleanup_listing;
 	}
-	free(files);
+	// fetching + printing files as they arrive
+	if (!(client = client_create())) goto cleanup_listing;
+	if (!remote_listing_fetch(client, argc ? *args : NULL, &listing, 1) && !listing.count && !output) printf("\n");
 	// cleanup
-	cleanup_response: free(index); free(response);
+	cleanup_client: api_client_destroy(client);
+	cleanup_listing: listing_destroy(&listing);
 }
 
 void cmd_upload(size_t argc, const char** args) {
 	// building file list
-	char** paths = NULL;
-	size_t pathc = 0;
-	if (!argc) pathc = paths_add(&paths, 0, ".");
-	else for (size_t i = 0; i < argc; i++) {
-		if (*args[i] == '-') {
-			const char* cmpstr = args[i] + 1;
-			size_t cmplen = strlen(cmpstr);
-			size_t j = 0;
-			for (size_t k = 0; k < pathc; j++, k++) {
-				while (k < pathc && !strncmp(paths[k], cmpstr, cmplen)) free(paths[k++]);
-				if (k < pathc) paths[j] = paths[k];
-			}
-			pathc = j;
-		}
-		else {
-			pathc = paths_add(&paths, pathc, args[i]);
-			if (!paths) break;
-		}
+	timing_phase("walk");
+	struct Ignore* ignore = ignore_rules_load();
+	if (!ignore) return;
+	// excluding paths by prefix, which works like an anchored rule ending in `*`
+	const char* includes[argc + 1];
+	size_t include_count = 0;
+	for (size_t i = 0; i < argc; i++) {
+		if (*args[i] != '-') {includes[include_count++] = args[i]; continue;}
+		const char* prefix = args[i] + 1;
+		if (*prefix == '.' && prefix[1] == '/') prefix += 2;
+		char rule[strlen(prefix) + 3];
+		sprintf(rule, "/%s*", prefix);
+		if (ignore_add(ignore, rule)) {print_error(ERROR_ALLOCATION); goto cleanup_ignore;}
 	}
-	if (!paths) {print_error(ERROR_ALLOCATION); return;}
+	if (!include_count) includes[include_count++] = ".";
+	struct PathTable paths;
+	if (paths_load(&paths, include_count, includes, ignore)) {print_error(ERROR_ALLOCATION); goto cleanup_ignore;}
+	char* buffer = malloc(paths.max_length + 1); // for reading paths back
+	if (!buffer) {print_error(ERROR_ALLOCATION); goto cleanup_paths;}
+	size_t pathc = paths.count;
 	if (!pathc) {print_error(ERROR_FILE_LIST_EMPTY); goto cleanup_paths;}
-	qsort(paths, pathc, sizeof(char*), string_sort);
 	// printing file list
 	print_success("found %d files:\n", pathc);
-	for (size_t i = 0; i < pathc; i++)
-		printf("    %s\n", paths[i]);
+	struct PathCursor cursor;
+	path_cursor_start(&cursor, &paths, 0, buffer);
+	for (const char* path; (path = path_cursor_next(&cursor));)
+		printf("    %s\n", path);
 	printf("\n");
 	// confirming upload
 	print_input("upload these files? (y/n)");
 	if (getchar() != 'y') {print_error("canceled upload"); goto cleanup_paths;}
 	// uploading files
 	print_loading("carrying files");
-	char key[KEY_SIZE];
-	get_key(key);
-	char* response = api_upload(key, pathc, (const char**)paths);
-	if (!response) {print_error(ERROR_RESPONSE_FETCH); goto cleanup_paths;}
-	// printing response
-	struct JSONIndex* index = json_index_object(response);
-	if (!index) print_error(ERROR_ALLOCATION);
-	else response_print_message(index, response_successful(index) ? print_success : print_error);
+	timing_phase("upload");
+	struct APIClient* client = client_create();
+	if (!client) goto cleanup_paths;
+	// recording uploads in the cached listing, whatever its age
+	struct Listing listing;
+	int cached = !listing_create(&listing) && !listing_load(&listing, LISTING_PATH, -1);
+	size_t failed = upload_table(client, &paths, cached ? &listing : NULL);
+	listing_destroy(&listing);
+	if (!failed) print_success("uploaded all %d files", pathc);
+	else print_error("%d of %d files weren't uploaded", failed, pathc);
+	api_client_destroy(client);
 	// cleanup
-	free(index);
-	free(response);
-	cleanup_paths: paths_destroy(paths, pathc);
+	cleanup_paths: free(buffer);
+	path_table_destroy(&paths);
+	cleanup_ignore: ignore_destroy(ignore);
 }
 
 void cmd_delete(size_t argc, const char** args) {
@@ -348,111 +857,423 @@ void cmd_delete(size_t argc, const char** args) {
 	if (getchar() != 'y') {print_error("canceled delete"); return;}
 	// deleting files
 	print_loading("letting loose");
-	char key[KEY_SIZE];
-	get_key(key);
-	char* response = api_delete(key, argc, args);
-	if (!response) {print_error(ERROR_RESPONSE_FETCH); return;}
-	// printing response
-	struct JSONIndex* index = json_index_object(response);
-	if (!index) print_error(ERROR_ALLOCATION);
-	else response_print_message(index, response_successful(index) ? print_success : print_error);
+	timing_phase("delete");
+	struct APIClient* client = client_create();
+	if (!client) return;
+	// removing deleted files from the cached listing, whatever its age
+	struct Listing listing;
+	if (listing_create(&listing)) {print_error(ERROR_ALLOCATION); goto cleanup_client;}
+	int cached = !listing_load(&listing, LISTING_PATH, -1);
+	size_t failed = delete_files(client, argc, args, cached ? &listing : NULL);
+	if (failed) print_error("%d of %d files weren't deleted", failed, argc);
 	// cleanup
-	free(index);
-	free(response);
+	listing_destroy(&listing);
+	cleanup_client: api_client_destroy(client);
 }
 
 /* utility commands */
 
+// prints one change found by diff. `remote` is whether `path` came from the listing, so is still json-escaped
+// `sign` is '+' where local is newer, or '-' where remote is, and `modified` is whether the file exists on both sides
+void change_print(const char* path, int remote, char sign, int modified) {
+	if (!output) {
+		printf("\e[%dm    %c %s  %s\n", sign == '+' ? 32 : 31, sign, modified ? "%" : " ", path);
+		return;
+	}
+	json_writer_open(output, '{');
+	json_writer_key(output, "path");
+	if (remote) json_writer_escaped(output, path, strlen(path));
+	else json_writer_string(output, path, strlen(path));
+	json_writer_key(output, "change");
+	if (sign == '+') json_writer_escaped(output, modified ? "modified" : "added", modified ? 8 : 5);
+	else json_writer_escaped(output, modified ? "outdated" : "removed", modified ? 8 : 7);
+	json_writer_close(output, '}');
+	json_writer_newline(output);
+}
+
+// prints the change between the local file at `path`, last modified at `local_time`, and the matching `remote` file, if they differ
+void change_compare(struct Manifest* manifest, const char* path, time_t local_time, const struct RemoteFile* remote) {
+	int cmp = difftime(remote->time, local_time);
+	struct stat statbuf;
+	// files with differing times may still have the same contents
+	if (cmp && !stat(path, &statbuf) && file_matches_remote(manifest, path, &statbuf, remote)) cmp = 0;
+	if (cmp < 0) change_print(path, 0, '+', 1);
+	else if (cmp > 0) change_print(remote->path, 1, '-', 1);
+}
+
+// a diff merging remote entries into the local paths as they arrive, keeping only the latest entry
+struct DiffStream {
+	const struct PathTable* local;
+	struct PathCursor cursor;
+	const char* path; // the next local path, or null once they've all been passed
+	struct Manifest* manifest;
+	const struct Ignore* ignore;
+	struct Arena* arena; // holds the latest entry
+	char* previous; // the latest entry's path, to check entries arrive sorted
+	size_t previous_cap;
+	int error; // 1 if memory couldn't be allocated, or 2 if entries arrived out of order
+};
+
+// compares one remote entry with the local paths up to it. used as an `api_list_stream` callback
+int diff_stream_entry(const char* json, void* data) {
+	struct DiffStream* stream = data;
+	arena_clear(stream->arena);
+	struct RemoteFile remote = {0};
+	unsigned long found;
+	if (json_bind(json, remote_file_fields, sizeof(remote_file_fields) / sizeof(*remote_file_fields), &remote, stream->arena, &found)) {stream->error = 1; return 1;}
+	if (!(found & 1 << REMOTE_FIELD_PATH)) return 0;
+	remote.has_sha1 = !!(found & 1 << REMOTE_FIELD_SHA1);
+	// a merge needs both sides sorted, which the listing can't be checked for until each entry arrives
+	size_t length = strlen(remote.path);
+	if (stream->previous && strcmp(stream->previous, remote.path) >= 0) {stream->error = 2; return 1;}
+	if (length + 1 > stream->previous_cap) {
+		char* previous = realloc(stream->previous, length + 1);
+		if (!previous) {stream->error = 1; return 1;}
+		stream->previous = previous;
+		stream->previous_cap = length + 1;
+	}
+	memcpy(stream->previous, remote.path, length + 1);
+	if (remote.is_directory || ignore_match(stream->ignore, remote.path, 0)) return 0;
+	// merging
+	int cmp;
+	while (stream->path && (cmp = strcmp(stream->path, remote.path)) < 0) {
+		change_print(stream->path, 0, '+', 0);
+		stream->path = path_cursor_next(&stream->cursor);
+	}
+	if (!stream->path || cmp) {change_print(remote.path, 1, '-', 0); return 0;}
+	change_compare(stream->manifest, stream->path, stream->local->times[stream->cursor.index - 1], &remote);
+	stream->path = path_cursor_next(&stream->cursor);
+	return 0;
+}
+
+// prints the differences between `local` and the remote listing as its entries arrive, without keeping them
+// returns 0 on success, or 1 on failure, after printing an error
+int diff_stream(struct APIClient* client, const struct PathTable* local, char* buffer, struct Manifest* manifest, const struct Ignore* ignore) {
+	struct DiffStream stream = {local};
+	path_cursor_start(&stream.cursor, local, 0, buffer);
+	stream.path = path_cursor_next(&stream.cursor);
+	stream.manifest = manifest;
+	stream.ignore = ignore;
+	if (!(stream.arena = arena_create())) {print_error(ERROR_ALLOCATION); return 1;}
+	char* response = api_list_stream(client, NULL, diff_stream_entry, &stream);
+	struct JSONIndex* index = NULL;
+	int error = 1;
+	if (stream.error == 1) print_error(ERROR_ALLOCATION);
+	else if (stream.error) print_error("the listing didn't arrive sorted, so can't be streamed. run diff without --stream");
+	else if (!response) print_error(ERROR_RESPONSE_FETCH);
+	else if (!(index = json_index_object(response, NULL))) print_error(ERROR_ALLOCATION);
+	else if (!response_successful(index)) response_print_message(index, print_error);
+	else error = 0;
+	// local files after the last remote one
+	for (; !error && stream.path; stream.path = path_cursor_next(&stream.cursor)) change_print(stream.path, 0, '+', 0);
+	free(index);
+	free(stream.previous);
+	arena_destroy(stream.arena);
+	return error;
+}
+
 void cmd_diff(size_t argc, const char** args) {
+	int stream = argc && !strcmp(*args, "--stream");
+	if (argc > (size_t)stream) {print_error("unrecognized argument: %s", args[stream]); return;}
 	print_loading("cross-referencing");
 	// building local file list
-	char** local_paths = NULL;
-	size_t local_count = paths_add(&local_paths, 0, ".");
-	if (!local_paths) {print_error(ERROR_ALLOCATION); return;}
-	if (!local_count) {print_error(ERROR_FILE_LIST_EMPTY); goto cleanup_local_paths;}
-	qsort(local_paths, local_count, sizeof(char*), string_sort);
+	timing_phase("walk");
+	struct Ignore* ignore = ignore_rules_load();
+	if (!ignore) return;
+	struct PathTable local;
+	const char* root = ".";
+	if (paths_load(&local, 1, &root, ignore)) {print_error(ERROR_ALLOCATION); goto cleanup_ignore;}
+	char* buffer = malloc(local.max_length + 1); // for reading paths back
+	if (!buffer) {print_error(ERROR_ALLOCATION); goto cleanup_local_paths;}
+	if (!local.count) {print_error(ERROR_FILE_LIST_EMPTY); goto cleanup_local_paths;}
 	// recording local file update times
-	time_t* local_times = malloc(local_count * sizeof(time_t));
-	if (!local_times) {print_error(ERROR_ALLOCATION); goto cleanup_local_paths;}
-	struct stat statbuf;
-	for (size_t i = 0; i < local_count; i++) {
-		stat(local_paths[i], &statbuf);
-		local_times[i] = statbuf.st_mtime;
+	timing_phase("stat");
+	if (path_table_stat(&local)) {print_error(ERROR_ALLOCATION); goto cleanup_local_paths;}
+	// loading cached hashes
+	timing_phase("manifest");
+	struct Manifest* manifest = manifest_load(MANIFEST_PATH);
+	if (!manifest) {print_error(ERROR_ALLOCATION); goto cleanup_local_paths;}
+	manifest_retain(manifest, &local);
+	struct APIClient* client = client_create();
+	if (!client) goto cleanup_manifest;
+	// comparing local and remote as the listing arrives
+	if (stream) {
+		timing_phase("stream");
+		print_success("local changes:\n");
+		int error = diff_stream(client, &local, buffer, manifest, ignore);
+		if (!output) printf("\e[0m\n");
+		if (error) goto cleanup_client;
+		goto save;
 	}
 	// fetching remote file list
-	char key[KEY_SIZE];
-	get_key(key);
-	char* response = api_list(key, NULL);
-	if (!response) {print_error(ERROR_RESPONSE_FETCH); goto cleanup_local_times;}
-	// parsing response
-	struct JSONIndex* index = json_index_object(response);
-	if (!index) {print_error(ERROR_ALLOCATION); goto cleanup_response;}
-	if (!response_successful(index)) {response_print_message(index, print_error); goto cleanup_response;}
-	// recording remote files + update times
-	struct JSONIndex* files = json_index_array(json_index_pair(index, "files"));
-	if (!files) {print_error(ERROR_ALLOCATION); goto cleanup_response;}
-	const char* buf;
-	char** remote_paths = NULL;
-	time_t* remote_times = NULL;
-	size_t remote_count = 0;
-	for (size_t i = 0; i < json_index_size(files); i++) {
-		struct JSONIndex* file = json_index_object(json_index_item(files, i));
-		if (!file) {print_error(ERROR_ALLOCATION); goto cleanup_response_files;}
-		if ((buf = json_index_pair(file, "is_directory")) && json_type(buf) == JSON_BOOL && json_bool(buf)) continue;
-		const char* buf;
-		time_t time;
-		char* path;
-		if (!(buf = json_index_pair(file, "updated_at")) || json_type(buf) != JSON_STRING) continue;
-		else time = string_to_time(buf + 1);
-		if (!(buf = json_index_pair(file, "path")) || json_type(buf) != JSON_STRING) continue;
-		else path = strndup(buf + 1, json_string_length(buf));
-		free(file);
-		if (!path) {print_error(ERROR_ALLOCATION); goto cleanup_response_files;}
-		array_add((void*)&remote_times, remote_count, sizeof(time_t), &time);
-		if (!remote_times) goto cleanup_remote_times;
-		array_add((void*)&remote_paths, remote_count, sizeof(char*), &path);
-		if (!remote_paths) goto cleanup_remote_paths;
-		remote_count++;
-	}
+	timing_phase("listing");
+	struct RemoteFileList remote;
+	if (remote_files_fetch(client, ignore, &remote)) goto cleanup_client;
+	// hashing files that need comparing
+	timing_phase("hash");
+	if (join_refresh(manifest, &local, &remote)) {print_error(ERROR_ALLOCATION); remote_files_destroy(&remote); goto cleanup_client;}
 	// comparing local and remote
+	timing_phase("compare");
 	print_success("local changes:\n");
-	size_t local_idx = 0;
+	struct PathCursor cursor;
+	path_cursor_start(&cursor, &local, 0, buffer);
+	const char* path = path_cursor_next(&cursor);
 	size_t remote_idx = 0;
-	while (local_idx < local_count && remote_idx < remote_count) {
-		int cmp = strcmp(local_paths[local_idx], remote_paths[remote_idx]);
-		if (cmp < 0) printf("\e[32m    +    %s\n", local_paths[local_idx++]);
-		else if (cmp > 0) printf("\e[31m    -    %s\n", remote_paths[remote_idx++]);
+	while (path || remote_idx < remote.count) {
+		int cmp = join_compare(path, remote.files, remote_idx, remote.count);
+		if (cmp < 0) {change_print(path, 0, '+', 0); path = path_cursor_next(&cursor);}
+		else if (cmp > 0) change_print(remote.files[remote_idx++].path, 1, '-', 0);
 		else {
-			cmp = difftime(remote_times[remote_idx++], local_times[local_idx++]);
-			if (cmp < 0) printf("\e[32m    + %%  %s\n", local_paths[local_idx]);
-			else if (cmp > 0) printf("\e[31m    - %%  %s\n", remote_paths[remote_idx]);
+			change_compare(manifest, path, local.times[cursor.index - 1], &remote.files[remote_idx++]);
+			path = path_cursor_next(&cursor);
+		}
+	}
+	if (!output) printf("\e[0m\n");
+	remote_files_destroy(&remote);
+	save:
+	timing_phase("save");
+	if (manifest_save(manifest, MANIFEST_PATH)) print_error("couldn't save %s", MANIFEST_PATH);
+	// cleanup
+	cleanup_client: api_client_destroy(client);
+	cleanup_manifest: manifest_destroy(manifest);
+	cleanup_local_paths: free(buffer);
+	path_table_destroy(&local);
+	cleanup_ignore: ignore_destroy(ignore);
+}
+
+void cmd_sync(size_t argc, const char** args) {
+	print_loading("taking fingerprints");
+	// building local file list
+	timing_phase("walk");
+	struct Ignore* ignore = ignore_rules_load();
+	if (!ignore) return;
+	struct PathTable local;
+	const char* root = ".";
+	if (paths_load(&local, 1, &root, ignore)) {print_error(ERROR_ALLOCATION); goto cleanup_ignore;}
+	char* buffer = malloc(local.max_length + 1); // for reading paths back
+	if (!buffer) {print_error(ERROR_ALLOCATION); goto cleanup_local_paths;}
+	if (!local.count) {print_error(ERROR_FILE_LIST_EMPTY); goto cleanup_local_paths;}
+	// loading cached hashes
+	timing_phase("manifest");
+	struct Manifest* manifest = manifest_load(MANIFEST_PATH);
+	if (!manifest) {print_error(ERROR_ALLOCATION); goto cleanup_local_paths;}
+	manifest_retain(manifest, &local);
+	// fetching remote file list
+	timing_phase("listing");
+	struct APIClient* client = client_create();
+	if (!client) goto cleanup_manifest;
+	struct RemoteFileList remote;
+	if (remote_files_fetch(client, ignore, &remote)) goto cleanup_client;
+	// hashing files that exist on both sides
+	timing_phase("hash");
+	if (join_refresh(manifest, &local, &remote)) {print_error(ERROR_ALLOCATION); goto cleanup_remote;}
+	// picking out new + changed files
+	timing_phase("compare");
+	struct PathList changed;
+	if (path_list_create(&changed)) {print_error(ERROR_ALLOCATION); goto cleanup_remote;}
+	unsigned long long changed_bytes = 0;
+	unsigned long long saved_bytes = 0;
+	struct PathCursor cursor;
+	path_cursor_start(&cursor, &local, 0, buffer);
+	const char* path = path_cursor_next(&cursor);
+	size_t remote_idx = 0;
+	struct stat statbuf;
+	for (; path; path = path_cursor_next(&cursor)) {
+		int cmp;
+		while ((cmp = join_compare(path, remote.files, remote_idx, remote.count)) > 0) remote_idx++;
+		if (stat(path, &statbuf)) {print_error("couldn't find file: %s", path); continue;}
+		if (!cmp && file_matches_remote(manifest, path, &statbuf, &remote.files[remote_idx++])) {
+			saved_bytes += statbuf.st_size;
+			continue;
 		}
+		if (path_list_add(&changed, path, strlen(path))) {print_error(ERROR_ALLOCATION); goto cleanup_changed_paths;}
+		changed_bytes += statbuf.st_size;
+	}
+	size_t changed_count = changed.count;
+	const char** changed_paths = (const char**)changed.paths;
+	if (!changed_count) {print_success("already in sync! skipped %llu bytes\n", saved_bytes); goto cleanup_changed_paths;}
+	// printing file list
+	print_success("found %d new or changed files (%llu bytes):\n", changed_count, changed_bytes);
+	for (size_t i = 0; i < changed_count; i++)
+		printf("    %s\n", changed_paths[i]);
+	printf("\n");
+	// confirming upload
+	print_input("upload these files? (y/n)");
+	if (getchar() != 'y') {print_error("canceled sync"); goto cleanup_changed_paths;}
+	// uploading files
+	print_loading("carrying files");
+	timing_phase("upload");
+	size_t failed = upload_files(client, changed_count, changed_paths, &remote.listing);
+	if (failed) print_error("%d of %d files weren't uploaded", failed, changed_count);
+	print_success("skipped %llu unchanged bytes", saved_bytes);
+	// cleanup
+	cleanup_changed_paths: path_list_destroy(&changed);
+	timing_phase("save");
+	if (manifest_save(manifest, MANIFEST_PATH)) print_error("couldn't save %s", MANIFEST_PATH);
+	cleanup_remote: remote_files_destroy(&remote);
+	cleanup_client: api_client_destroy(client);
+	cleanup_manifest: manifest_destroy(manifest);
+	cleanup_local_paths: free(buffer);
+	path_table_destroy(&local);
+	cleanup_ignore: ignore_destroy(ignore);
+}
+
+void cmd_prune(size_t argc, const char** args) {
+	print_loading("looking for strays");
+	// building local file list
+	timing_phase("walk");
+	struct Ignore* ignore = ignore_rules_load();
+	if (!ignore) return;
+	struct PathTable local;
+	const char* root = ".";
+	if (paths_load(&local, 1, &root, ignore)) {print_error(ERROR_ALLOCATION); goto cleanup_ignore;}
+	char* buffer = malloc(local.max_length + 1); // for reading paths back
+	if (!buffer) {print_error(ERROR_ALLOCATION); goto cleanup_local_paths;}
+	// an empty site root is more likely a mistake than a request to delete everything
+	if (!local.count) {print_error(ERROR_FILE_LIST_EMPTY); goto cleanup_local_paths;}
+	// fetching remote file list
+	timing_phase("listing");
+	struct APIClient* client = client_create();
+	if (!client) goto cleanup_local_paths;
+	struct RemoteFileList remote;
+	if (remote_files_fetch(client, ignore, &remote)) goto cleanup_client;
+	// picking out remote files missing locally
+	timing_phase("compare");
+	const char** missing_paths = NULL;
+	size_t missing_count = 0;
+	unsigned long long missing_bytes = 0;
+	struct PathCursor cursor;
+	path_cursor_start(&cursor, &local, 0, buffer);
+	const char* path = path_cursor_next(&cursor);
+	size_t remote_idx = 0;
+	while (remote_idx < remote.count) {
+		int cmp = join_compare(path, remote.files, remote_idx, remote.count);
+		if (cmp < 0) {path = path_cursor_next(&cursor); continue;}
+		const struct RemoteFile* file = &remote.files[remote_idx++];
+		if (!cmp) {path = path_cursor_next(&cursor); continue;}
+		if (array_add((void*)&missing_paths, missing_count, sizeof(char*), &file->path)) {print_error(ERROR_ALLOCATION); goto cleanup_missing_paths;}
+		missing_count++;
+		missing_bytes += file->size;
 	}
-	while (local_idx < local_count) printf("\e[32m    +    %s\n", local_paths[local_idx++]);
-	while (remote_idx < remote_count) printf("\e[31m    -    %s\n", remote_paths[remote_idx++]);
+	if (!missing_count) {print_success("nothing to prune!\n"); goto cleanup_missing_paths;}
+	// printing file list
+	print_success("found %d remote files missing locally (%llu bytes):\n", missing_count, missing_bytes);
+	for (size_t i = 0; i < missing_count; i++)
+		printf("    %s\n", missing_paths[i]);
 	printf("\n");
+	// confirming delete
+	print_input("delete these files? (y/n)");
+	if (getchar() != 'y') {print_error("canceled prune"); goto cleanup_missing_paths;}
+	// deleting files
+	print_loading("letting loose");
+	timing_phase("delete");
+	size_t failed = delete_files(client, missing_count, missing_paths, &remote.listing);
+	if (failed) print_error("%d of %d files weren't deleted", failed, missing_count);
+	// cleanup
+	cleanup_missing_paths: free(missing_paths);
+	remote_files_destroy(&remote);
+	cleanup_client: api_client_destroy(client);
+	cleanup_local_paths: free(buffer);
+	path_table_destroy(&local);
+	cleanup_ignore: ignore_destroy(ignore);
+}
+
+// mirrors one round of watched changes: uploads changed files whose contents differ from `listing`,
+// and deletes removed files that `listing` has
+// returns 0 on success, or 1 if memory couldn't be allocated
+int watch_flush(struct APIClient* client, const struct Ignore* ignore, struct Listing* listing, struct PathList* changed, struct PathList* removed) {
+	struct PathList uploads;
+	if (path_list_create(&uploads)) return 1;
+	// changed directories are walked, as their files may not have been watched yet
+	// paths that are gone were in a directory moved away since they changed
+	for (size_t i = 0; i < changed->count; i++)
+		if (!access(changed->paths[i], F_OK) && paths_add(&uploads, changed->paths[i], ignore)) {path_list_destroy(&uploads); return 1;}
+	// files in new directories are seen by both the walk and the watch
+	if (uploads.count) qsort(uploads.paths, uploads.count, sizeof(char*), string_sort);
+	size_t kept = 0;
+	for (size_t i = 0; i < uploads.count; i++) {
+		if (i && !strcmp(uploads.paths[i], uploads.paths[i - 1])) continue;
+		const struct RemoteFile* file = listing_find(listing, uploads.paths[i]);
+		unsigned char sha1[SHA1_LENGTH];
+		// editors often save files without changing them
+		if (file && file->has_sha1 && !sha1_file(uploads.paths[i], sha1) && !memcmp(sha1, file->sha1, SHA1_LENGTH)) continue;
+		uploads.paths[kept++] = uploads.paths[i];
+	}
+	uploads.count = kept;
+	if (uploads.count) upload_files(client, uploads.count, (const char**)uploads.paths, listing);
+	path_list_destroy(&uploads);
+	// deleting a file neocities doesn't have would fail its whole batch,
+	// so files are left out if they were never uploaded, or are in a removed directory that's deleted with them
+	// (kept paths are gathered at the end, as directories sort before their files, which are searched for them)
+	if (removed->count) qsort(removed->paths, removed->count, sizeof(char*), string_sort);
+	kept = removed->count;
+	for (size_t i = removed->count; i--;) {
+		char* path = removed->paths[i];
+		int covered = 0;
+		for (char* slash = strchr(path, '/'); slash && !covered; slash = strchr(slash + 1, '/')) {
+			*slash = 0;
+			covered = !!bsearch(&path, removed->paths, i, sizeof(char*), string_sort);
+			*slash = '/';
+		}
+		if (!covered && listing_find(listing, path)) removed->paths[--kept] = path;
+	}
+	removed->count -= kept;
+	if (removed->count) {
+		memmove(removed->paths, removed->paths + kept, removed->count * sizeof(char*));
+		delete_files(client, removed->count, (const char**)removed->paths, listing);
+	}
+	fflush(stdout);
+	return 0;
+}
+
+void cmd_watch(size_t argc, const char** args) {
+	print_loading("keeping watch");
+	struct Ignore* ignore = ignore_rules_load();
+	if (!ignore) return;
+	struct Watch* watch = watch_create(ignore);
+	if (!watch) goto cleanup_ignore;
+	// one client is kept for the whole watch, so its connection stays open between changes
+	struct APIClient* client = client_create();
+	if (!client) goto cleanup_watch;
+	struct Listing listing;
+	if (listing_create(&listing)) {print_error(ERROR_ALLOCATION); goto cleanup_client;}
+	if (listing_load(&listing, LISTING_PATH, options.cache_ttl) && remote_listing_fetch(client, NULL, &listing, 0)) goto cleanup_listing;
+	listing_sort(&listing);
+	// mirroring changes until stopped
+	print_success("watching for changes (ctrl+c to stop)");
+	fflush(stdout);
+	for (int error = 0; !error;) {
+		struct PathList changed, removed;
+		if (path_list_create(&changed)) {print_error(ERROR_ALLOCATION); break;}
+		if (path_list_create(&removed)) {print_error(ERROR_ALLOCATION); path_list_destroy(&changed); break;}
+		if (!(error = watch_wait(watch, WATCH_DEBOUNCE, &changed, &removed)) && (error = watch_flush(client, ignore, &listing, &changed, &removed)))
+			print_error(ERROR_ALLOCATION);
+		path_list_destroy(&changed);
+		path_list_destroy(&removed);
+	}
 	// cleanup
-	cleanup_remote_times: free(remote_times);
-	cleanup_remote_paths: paths_destroy(remote_paths, remote_count);
-	cleanup_response_files: free(files);
-	cleanup_response: free(index); free(response);
-	cleanup_local_times: free(local_times);
-	cleanup_local_paths: paths_destroy(local_paths, local_count);
+	cleanup_listing: listing_destroy(&listing);
+	cleanup_client: api_client_destroy(client);
+	cleanup_watch: watch_destroy(watch);
+	cleanup_ignore: ignore_destroy(ignore);
 }
 
 /* printers with emoticon prefixes.
    these sometimes fail to print their emoticons?? not sure why */
 
 void print_error(const char* format, ...) {
-	printf("\e[31m%s\e[0m ", &":( \0:'(\0D: \0D':\0:< \0:'< \0:(c"[rand() % 7 * 4]);
+	// errors stay out of json output, and plain
+	FILE* stream = output ? stderr : stdout;
+	if (!output) fprintf(stream, "\e[31m%s\e[0m ", &":( \0:'(\0D: \0D':\0:< \0:'< \0:(c"[rand() % 7 * 4]);
 	va_list args;
 	va_start(args, format);
-	vprintf(format, args);
+	vfprintf(stream, format, args);
 	va_end(args);
-	printf("\n");
+	fprintf(stream, "\n");
 }
 
 void print_success(const char* format, ...) {
+	if (output) return;
 	printf("\e[32m%s\e[0m ", &":) \0:D \0^_^\0^u^\0*O*\0:3 "[rand() % 6 * 4]);
 	va_list args;
 	va_start(args, format);
@@ -462,9 +1283,12 @@ void print_success(const char* format, ...) {
 }
 
 void print_loading(const char* message) {
+	if (output) return;
 	printf("\e[33mP:\e[0m  %s...\n", message);
 }
 
 void print_input(const char* message) {
+	// time spent waiting for input isn't part of any phase
+	timing_phase(NULL);
 	printf("\e[33m%s\e[0m %s ", &"<o<\0u_u\0:? \0oxo\0`u`"[rand() % 5 * 4], message);
 }
\ No newline at end of file
@@ -15,24 +15,42 @@ void cmd_help(size_t argc, const char** args);
 // if [sitename] is absent, the api key is used to display its associated site
 void cmd_info(size_t argc, const char** args);
 
-// usage: list [path]
+// usage: list [path] [query]
 // lists all remote files
 // if [path] is present, lists only the contents of the remote directory at [path]
+// [query] terms filter, sort, limit or total the entries, answered locally from the full listing (see query.h)
 void cmd_list(size_t argc, const char** args);
 
 // usage: upload [paths]
 // recursively uploads local files to the remote root. separate multiple paths with spaces; exclude paths by prefixing them with '-'
 // if [paths] is absent, uploads all local files
+// files are uploaded in concurrent batches; see --connections
 void cmd_upload(size_t argc, const char** args);
 
 // usage: delete [paths]
 // deletes remote files. separate multiple paths with spaces
+// files are deleted in concurrent batches; see --connections
 void cmd_delete(size_t argc, const char** args);
 
-// usage: diff
+// usage: diff [--stream]
 // lists differences between local and remote files, based on their paths and update times
+// files whose contents match their remote copies are unchanged. local hashes are cached in the site root
+// with --stream, changes are printed as the remote listing arrives, which is neither kept nor cached. it must arrive sorted by path
 void cmd_diff(size_t argc, const char** args);
 
+// usage: sync
+// uploads local files that are new or whose contents differ from their remote copies, based on their sha1 hashes
+void cmd_sync(size_t argc, const char** args);
+
+// usage: prune
+// deletes remote files that don't exist locally, after confirming. ignored files are left alone
+void cmd_prune(size_t argc, const char** args);
+
+// usage: watch
+// uploads local files as they change and deletes remote files as local ones are removed, until stopped
+// changes are collected until none arrive for a moment, then mirrored together. linux only
+void cmd_watch(size_t argc, const char** args);
+
 /* printers */
 
 void print_error(const char* format, ...);
@@ -0,0 +1,162 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fnmatch.h>
+#include "arena.h"
+#include "ignore.h"
+
+#define IGNORE_MAX_STATES 256
+#define RULES_REALLOC_STEP 32
+
+// a segment in the rule trie
+// rules are numbered from 1, so 0 means no rule ends at a node
+struct IgnoreNode {
+	const char* segment;
+	int literal; // has no glob characters, so can be compared directly
+	int globstar; // is `**`
+	size_t rule; // the last rule ending here
+	size_t dir_rule; // the last rule ending here that only matches directories
+	struct IgnoreNode* child;
+	struct IgnoreNode* sibling;
+};
+
+struct Ignore {
+	struct Arena* arena; // holds nodes + segments
+	struct IgnoreNode root;
+	unsigned char* negated; // whether each rule starts with `!`, by rule number - 1
+	size_t rules;
+};
+
+/* helpers */
+
+// returns the child of `node` for `segment`, adding it if it doesn't exist
+// returns null if memory couldn't be allocated
+struct IgnoreNode* ignore_child(struct Ignore* ignore, struct IgnoreNode* node, const char* segment, size_t length) {
+	for (struct IgnoreNode* child = node->child; child; child = child->sibling)
+		if (!strncmp(child->segment, segment, length) && !child->segment[length]) return child;
+	struct IgnoreNode* child = arena_alloc(ignore->arena, sizeof(struct IgnoreNode));
+	char* copy = arena_alloc(ignore->arena, length + 1);
+	if (!child || !copy) return NULL;
+	memcpy(copy, segment, length);
+	copy[length] = 0;
+	*child = (struct IgnoreNode){copy, !strpbrk(copy, "*?[\\"), !strcmp(copy, "**"), 0, 0, NULL, node->child};
+	node->child = child;
+	return child;
+}
+
+// adds `node` to a set of states, along with the `**` children it can reach without matching a segment
+void ignore_state_add(const struct IgnoreNode** states, size_t* size, const struct IgnoreNode* node) {
+	for (size_t i = 0; i < *size; i++)
+		if (states[i] == node) return;
+	if (*size == IGNORE_MAX_STATES) return;
+	states[(*size)++] = node;
+	for (const struct IgnoreNode* child = node->child; child; child = child->sibling)
+		if (child->globstar) ignore_state_add(states, size, child);
+}
+
+// returns the number of the last rule matching a set of states, or 0 if none do
+size_t ignore_state_rule(const struct IgnoreNode** states, size_t size, int is_dir) {
+	size_t rule = 0;
+	for (size_t i = 0; i < size; i++) {
+		if (states[i]->rule > rule) rule = states[i]->rule;
+		if (is_dir && states[i]->dir_rule > rule) rule = states[i]->dir_rule;
+	}
+	return rule;
+}
+
+/* interface */
+
+struct Ignore* ignore_create(void) {
+	struct Ignore* ignore = calloc(1, sizeof(struct Ignore));
+	if (!ignore) return NULL;
+	if (!(ignore->arena = arena_create())) {free(ignore); return NULL;}
+	ignore->root.segment = "";
+	return ignore;
+}
+
+int ignore_add(struct Ignore* ignore, const char* rule) {
+	size_t length = strlen(rule);
+	while (length && (rule[length - 1] == '\n' || rule[length - 1] == '\r' || rule[length - 1] == ' ')) length--;
+	if (!length || *rule == '#') return 0;
+	int negated = *rule == '!';
+	if (negated) rule++, length--;
+	int dir_only = length && rule[length - 1] == '/';
+	if (dir_only) length--;
+	// anchoring
+	struct IgnoreNode* node = &ignore->root;
+	const char* slash = memchr(rule, '/', length);
+	if (!slash && !(node = ignore_child(ignore, node, "**", 2))) return 1;
+	// adding segments
+	const char* end = rule + length;
+	while (rule < end) {
+		const char* segment_end = memchr(rule, '/', end - rule);
+		if (!segment_end) segment_end = end;
+		if (segment_end > rule && !(node = ignore_child(ignore, node, rule, segment_end - rule))) return 1;
+		rule = segment_end + 1;
+	}
+	if (node == &ignore->root) return 0;
+	// numbering the rule
+	if (ignore->rules % RULES_REALLOC_STEP == 0) {
+		unsigned char* negated_rules = realloc(ignore->negated, ignore->rules + RULES_REALLOC_STEP);
+		if (!negated_rules) return 1;
+		ignore->negated = negated_rules;
+	}
+	ignore->negated[ignore->rules++] = negated;
+	if (dir_only) node->dir_rule = ignore->rules;
+	else node->rule = ignore->rules;
+	return 0;
+}
+
+int ignore_load(struct Ignore* ignore, const char* path) {
+	FILE* file = fopen(path, "r");
+	if (!file) return 0;
+	char* line = NULL;
+	size_t line_cap = 0;
+	int error = 0;
+	while (!error && getline(&line, &line_cap, file) > 0) error = ignore_add(ignore, line);
+	free(line);
+	fclose(file);
+	return error;
+}
+
+int ignore_match(const struct Ignore* ignore, const char* path, int is_dir) {
+	if (!ignore || !ignore->rules) return 0;
+	const struct IgnoreNode* states[2][IGNORE_MAX_STATES];
+	size_t size = 0;
+	int current = 0;
+	ignore_state_add(states[current], &size, &ignore->root);
+	while (*path) {
+		// matching one segment
+		const char* end = strchr(path, '/');
+		size_t length = end ? (size_t)(end - path) : strlen(path);
+		char segment[length + 1];
+		memcpy(segment, path, length);
+		segment[length] = 0;
+		const struct IgnoreNode** next = states[!current];
+		size_t next_size = 0;
+		for (size_t i = 0; i < size; i++) {
+			const struct IgnoreNode* node = states[current][i];
+			if (node->globstar) ignore_state_add(next, &next_size, node);
+			for (const struct IgnoreNode* child = node->child; child; child = child->sibling)
+				if (!child->globstar && (child->literal ? !strcmp(child->segment, segment) : !fnmatch(child->segment, segment, 0)))
+					ignore_state_add(next, &next_size, child);
+		}
+		current = !current;
+		size = next_size;
+		path += length;
+		while (*path == '/') path++;
+		// excluding everything in an excluded directory
+		size_t rule = ignore_state_rule(states[current], size, *path || is_dir);
+		if (rule && !ignore->negated[rule - 1] && *path) return 1;
+		if (!*path) return rule && !ignore->negated[rule - 1];
+		if (!size) return 0;
+	}
+	return 0;
+}
+
+void ignore_destroy(struct Ignore* ignore) {
+	if (!ignore) return;
+	arena_destroy(ignore->arena);
+	free(ignore->negated);
+	free(ignore);
+}
\ No newline at end of file
@@ -0,0 +1,30 @@
+/* ignore rules
+   decide which local paths are left out of uploads + diffs, from gitignore-style rules like those in .neocignore.
+   each rule is a glob matched against a path one segment at a time:
+     `*`, `?` and `[...]` match within a segment, and a `**` segment matches any number of segments
+     a leading `!` brings back paths excluded by earlier rules
+     a trailing `/` only matches directories
+     a rule with a slash anywhere but its end is anchored to the site root. otherwise, it matches at any depth
+   the last matching rule wins, and excluding a directory excludes everything in it.
+   rules are compiled into a trie of segments, which paths are matched against all at once */
+
+#define IGNORE_PATH ".neocignore"
+
+struct Ignore;
+
+// returns an empty rule set, or null if memory couldn't be allocated
+struct Ignore* ignore_create(void);
+
+// adds a rule, as one line of an ignore file. blank lines and lines starting with `#` are skipped
+// returns 0 on success, or 1 if memory couldn't be allocated
+int ignore_add(struct Ignore* ignore, const char* rule);
+
+// adds every rule in the file at `path`, if it exists
+// returns 0 on success, or 1 if memory couldn't be allocated
+int ignore_load(struct Ignore* ignore, const char* path);
+
+// returns 1 if `path` (relative to the site root) is excluded, either itself or through a directory it's in
+// `ignore` may be null, in which case nothing is excluded
+int ignore_match(const struct Ignore* ignore, const char* path, int is_dir);
+
+void ignore_destroy(struct Ignore* ignore);
\ No newline at end of file
@@ -2,29 +2,135 @@
 #include <string.h>
 #include <ctype.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include "arena.h"
 #include "json.h"
 
-#define INDEX_REALLOC_STEP 16
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define JSON_SCAN_X86
+#endif
+
+#define INDEX_INITIAL_CAP 16
+#define WRITER_BUFFER_SIZE 262144
+
+/* structural scanning
+   finds the next of a set of structural characters (or the null terminator) many bytes at a time.
+   vector kernels only do aligned loads, which can't cross into an unmapped page past the terminator */
+
+enum JSONScan {
+	SCAN_STRING, // the end of a string, or an escape
+	SCAN_NEST, // brackets + strings
+	SCAN_SEPARATOR, // the end of a value
+};
+
+const char* scan_chars[] = {"\"\\", "\"{}[]", ",}]"};
+
+unsigned char scan_table[3][256];
+
+// one byte at a time, for when no vector kernel is available
+const char* scan_scalar(const char* json, enum JSONScan set) {
+	while (!scan_table[set][(unsigned char)*json]) json++;
+	return json;
+}
+
+#ifdef JSON_SCAN_X86
+__attribute__((target("sse2"), no_sanitize_address))
+const char* scan_sse2(const char* json, enum JSONScan set) {
+	const char* chars = scan_chars[set];
+	__m128i targets[5];
+	int count = 0;
+	for (; chars[count]; count++) targets[count] = _mm_set1_epi8(chars[count]);
+	uintptr_t offset = (uintptr_t)json & 15;
+	const __m128i* block = (const __m128i*)(json - offset);
+	unsigned mask = ~0u << offset; // ignoring bytes before `json` in the first block
+	for (;; block++, mask = ~0u) {
+		__m128i data = _mm_load_si128(block);
+		__m128i hits = _mm_cmpeq_epi8(data, _mm_setzero_si128());
+		for (int i = 0; i < count; i++) hits = _mm_or_si128(hits, _mm_cmpeq_epi8(data, targets[i]));
+		unsigned bits = _mm_movemask_epi8(hits) & mask;
+		if (bits) return (const char*)block + __builtin_ctz(bits);
+	}
+}
+
+__attribute__((target("avx2"), no_sanitize_address))
+const char* scan_avx2(const char* json, enum JSONScan set) {
+	const char* chars = scan_chars[set];
+	__m256i targets[5];
+	int count = 0;
+	for (; chars[count]; count++) targets[count] = _mm256_set1_epi8(chars[count]);
+	uintptr_t offset = (uintptr_t)json & 31;
+	const __m256i* block = (const __m256i*)(json - offset);
+	uint32_t mask = ~(uint32_t)0 << offset;
+	for (;; block++, mask = ~(uint32_t)0) {
+		__m256i data = _mm256_load_si256(block);
+		__m256i hits = _mm256_cmpeq_epi8(data, _mm256_setzero_si256());
+		for (int i = 0; i < count; i++) hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(data, targets[i]));
+		uint32_t bits = (uint32_t)_mm256_movemask_epi8(hits) & mask;
+		if (bits) return (const char*)block + __builtin_ctz(bits);
+	}
+}
+#endif
+
+const char* scan_init(const char* json, enum JSONScan set);
+
+const char* (*scan)(const char* json, enum JSONScan set) = scan_init;
+
+// picks the fastest kernel the cpu supports on first use
+const char* scan_init(const char* json, enum JSONScan set) {
+	for (int i = 0; i < 3; i++) {
+		scan_table[i][0] = 1;
+		for (const char* c = scan_chars[i]; *c; c++) scan_table[i][(unsigned char)*c] = 1;
+	}
+	scan = scan_scalar;
+	#ifdef JSON_SCAN_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) scan = scan_avx2;
+	else if (__builtin_cpu_supports("sse2")) scan = scan_sse2;
+	#endif
+	return scan(json, set);
+}
 
 /* string helpers */
 
+// returns whether `c` is json whitespace
+int is_space(char c) {
+	return c == ' ' || c == '\n' || c == '\t' || c == '\r';
+}
+
 // returns a pointer to the first non-whitespace character in `json`
 const char* skip_space(const char* json) {
-	while (isspace(*json)) json++;
+	while (is_space(*json)) json++;
 	return json;
 }
 
+// returns a pointer to just after the string at `json`
+const char* skip_string(const char* json) {
+	json += json_string_length(json) + 1;
+	return *json ? json + 1 : json;
+}
+
 // returns a pointer to just after the object/array at `json`
 const char* skip_nest(const char* json) {
 	unsigned nest = 1;
-	while (nest) switch (*++json) {
-		case '{': case '[': nest++; break;
-		case '}': case ']': nest--; break;
+	json++;
+	while (nest) switch (*(json = scan(json, SCAN_NEST))) {
+		case '"': json = skip_string(json); break;
+		case '{': case '[': nest++; json++; break;
+		case '}': case ']': nest--; json++; break;
 		case '\0': return json;
 	}
 	return json;
 }
 
+// returns a pointer to just after the value at `json`
+const char* skip_value(const char* json) {
+	if (*json == '{' || *json == '[') return skip_nest(json);
+	if (*json == '"') return skip_string(json);
+	return json;
+}
+
 /* type */
 
 enum JSONType json_type(const char* json) {
@@ -33,10 +139,10 @@ enum JSONType json_type(const char* json) {
 		case '[': return JSON_ARRAY;
 		case '"': return JSON_STRING;
 	}
-	if (isdigit(*json)) while (1) {
-		if (!isdigit(*json)) return JSON_INT;
-		if (*json == '.') return JSON_FLOAT;
-		json++;
+	if (*json == '-' || isdigit((unsigned char)*json)) {
+		if (*json == '-' && !isdigit((unsigned char)*++json)) return JSON_UNKNOWN;
+		while (isdigit((unsigned char)*json)) json++;
+		return *json == '.' || *json == 'e' || *json == 'E' ? JSON_FLOAT : JSON_INT;
 	}
 	if (!strncmp(json, "true", 4) || !strncmp(json, "false", 5)) return JSON_BOOL;
 	if (!strncmp(json, "null", 4)) return JSON_NULL;
@@ -50,18 +156,28 @@ struct JSONIndex {
 	const char* items[];
 };
 
-struct JSONIndex* json_index_object(const char* json) {
-	struct JSONIndex* index = malloc(sizeof(struct JSONIndex));
+// resizes `index` from `cap` to `new_cap` items, allocating from `arena` if it isn't null
+// on failure, frees a heap-allocated index and returns null
+struct JSONIndex* json_index_resize(struct JSONIndex* index, size_t cap, size_t new_cap, struct Arena* arena) {
+	size_t size = sizeof(struct JSONIndex) + new_cap * sizeof(char*);
+	struct JSONIndex* resized = arena ? arena_realloc(arena, index, sizeof(struct JSONIndex) + cap * sizeof(char*), size) : realloc(index, size);
+	if (!resized && !arena) free(index);
+	return resized;
+}
+
+struct JSONIndex* json_index_object(const char* json, struct Arena* arena) {
+	struct JSONIndex* index = json_index_resize(NULL, 0, 0, arena);
 	if (!index) return NULL;
 	index->size = 0;
 	size_t cap = 0;
+	if (*json != '{') return index;
 	// indexing
 	json = skip_space(json + 1);
 	if (*json != '}') do {
 		while (index->size >= cap) {
-			struct JSONIndex* tmp = realloc(index, sizeof(struct JSONIndex) + (cap += INDEX_REALLOC_STEP * 2) * sizeof(char*));
-			if (!tmp) {free(index); return NULL;}
-			index = tmp;
+			size_t new_cap = cap ? cap * 2 : INDEX_INITIAL_CAP;
+			if (!(index = json_index_resize(index, cap, new_cap, arena))) return NULL;
+			cap = new_cap;
 		}
 		// key
 		json = skip_space(json);
@@ -75,42 +191,38 @@ struct JSONIndex* json_index_object(const char* json) {
 		json = skip_space(json + 1);
 		if (!*json) break;
 		index->items[index->size++] = json;
-		if (*json == '{' || *json == '[') json = skip_nest(json);
-		else if (*json == '"') json += json_string_length(json) + 1;
-		json = strpbrk(json, ",]");
-		if (!json) break;
+		json = scan(skip_value(json), SCAN_SEPARATOR);
 	} while (*json++ == ',');
 	return index;
 }
 
-struct JSONIndex* json_index_array(const char* json) {
-	struct JSONIndex* index = malloc(sizeof(struct JSONIndex));
+struct JSONIndex* json_index_array(const char* json, struct Arena* arena) {
+	struct JSONIndex* index = json_index_resize(NULL, 0, 0, arena);
 	if (!index) return NULL;
 	index->size = 0;
 	size_t cap = 0;
+	if (*json != '[') return index;
 	// indexing
 	json = skip_space(json + 1);
 	if (*json != ']') do {
 		while (index->size >= cap) {
-			struct JSONIndex* tmp = realloc(index, sizeof(struct JSONIndex) + (cap += INDEX_REALLOC_STEP) * sizeof(char*));
-			if (!tmp) {free(index); return NULL;}
-			index = tmp;
+			size_t new_cap = cap ? cap * 2 : INDEX_INITIAL_CAP;
+			if (!(index = json_index_resize(index, cap, new_cap, arena))) return NULL;
+			cap = new_cap;
 		}
 		// value
 		json = skip_space(json);
 		if (!*json) break;
 		index->items[index->size++] = json;
-		if (*json == '{' || *json == '[') json = skip_nest(json);
-		else if (*json == '"') json += json_string_length(json) + 1;
-		json = strpbrk(json, ",]");
-		if (!json) break;
+		json = scan(skip_value(json), SCAN_SEPARATOR);
 	} while (*json++ == ',');
 	return index;
 }
 
 const char* json_index_pair(const struct JSONIndex* index, const char* key) {
+	size_t length = strlen(key);
 	for (size_t i = 0; i < index->size; i += 2)
-		if (!strncmp(key, index->items[i] + 1, strlen(key)))
+		if (!strncmp(key, index->items[i] + 1, length) && index->items[i][length + 1] == '"')
 			return i + 1 == index->size ? NULL : index->items[i + 1];
 	return NULL;
 }
@@ -123,18 +235,297 @@ size_t json_index_size(const struct JSONIndex* index) {
 	return index->size;
 }
 
+/* binding */
+
+// decodes the value at `json` into the member for `field`
+// returns 0 on success, 1 if the value doesn't fit the field, or -1 if memory couldn't be allocated
+int bind_value(const char* json, const struct JSONField* field, char* member, struct Arena* arena) {
+	enum JSONType type = json_type(json);
+	switch (field->type) {
+		case BIND_STRING: {
+			if (type != JSON_STRING) return 1;
+			size_t length = json_string_length(json);
+			char* string = arena_alloc(arena, length + 1);
+			if (!string) return -1;
+			memcpy(string, json + 1, length);
+			string[length] = 0;
+			*(char**)member = string;
+			return 0;
+		}
+		case BIND_INT:
+			if (type != JSON_INT) return 1;
+			*(int64_t*)member = strtoll(json, NULL, 10);
+			return 0;
+		case BIND_BOOL:
+			if (type != JSON_BOOL) return 1;
+			*(int*)member = json_bool(json);
+			return 0;
+		case BIND_CUSTOM:
+			return field->parse(json, member) ? 1 : 0;
+	}
+	return 1;
+}
+
+int json_bind(const char* json, const struct JSONField* fields, size_t fieldc, void* out, struct Arena* arena, unsigned long* found) {
+	*found = 0;
+	if (*json != '{') return 0;
+	json = skip_space(json + 1);
+	if (*json != '}') do {
+		// key
+		json = skip_space(json);
+		if (*json != '"') break;
+		const char* key = json + 1;
+		size_t length = json_string_length(json);
+		json = skip_space(skip_string(json));
+		if (*json != ':') break;
+		// value
+		json = skip_space(json + 1);
+		if (!*json) break;
+		for (size_t i = 0; i < fieldc; i++)
+			if (!strncmp(fields[i].key, key, length) && !fields[i].key[length]) {
+				int result = bind_value(json, &fields[i], (char*)out + fields[i].offset, arena);
+				if (result < 0) return 1;
+				if (!result) *found |= 1ul << i;
+				break;
+			}
+		json = scan(skip_value(json), SCAN_SEPARATOR);
+	} while (*json++ == ',');
+	return 0;
+}
+
 /* value */
 
 size_t json_string_length(const char* json) {
-	size_t length = 0;
-	int escape = 0;
-	while (*++json && (*json != '"' || escape)) {
-		escape = *json == '\\' ? !escape : 0;
-		length++;
-	}
-	return length;
+	const char* end = json + 1;
+	while (*(end = scan(end, SCAN_STRING)) == '\\') end += end[1] ? 2 : 1;
+	return end - json - 1;
 }
 
 int json_bool(const char* json) {
 	return *json == 't';
+}
+
+/* stream */
+
+struct JSONBuffer {
+	char* data;
+	size_t length;
+	size_t cap;
+};
+
+struct JSONStream {
+	const char* key;
+	int(*callback)(const char* json, void* data);
+	void* data;
+	struct JSONBuffer rest; // the document outside of the streamed array
+	struct JSONBuffer value; // the array value being read
+	size_t key_start; // position of the last top-level string in `rest`
+	size_t key_end;
+	unsigned depth;
+	int string;
+	int escape;
+	int streaming; // whether the stream is inside the array at `key`
+	int reading; // whether the stream is inside one of the array's values
+};
+
+// appends `c` to `buffer`, growing it geometrically. returns 0 on success
+int json_buffer_add(struct JSONBuffer* buffer, char c) {
+	if (buffer->length + 1 >= buffer->cap) {
+		size_t cap = buffer->cap ? buffer->cap * 2 : 256;
+		char* data = realloc(buffer->data, cap);
+		if (!data) return 1;
+		buffer->data = data;
+		buffer->cap = cap;
+	}
+	buffer->data[buffer->length++] = c;
+	buffer->data[buffer->length] = 0;
+	return 0;
+}
+
+struct JSONStream* json_stream_create(const char* key, int(*callback)(const char* json, void* data), void* data) {
+	struct JSONStream* stream = calloc(1, sizeof(struct JSONStream));
+	if (!stream) return NULL;
+	stream->key = key;
+	stream->callback = callback;
+	stream->data = data;
+	return stream;
+}
+
+// passes the completed array value to the callback. returns 0 to continue streaming
+int json_stream_emit(struct JSONStream* stream) {
+	stream->reading = 0;
+	int result = stream->callback(stream->value.data, stream->data);
+	stream->value.length = 0;
+	return result;
+}
+
+int json_stream_feed(struct JSONStream* stream, const char* chunk, size_t size) {
+	for (size_t i = 0; i < size; i++) {
+		char c = chunk[i];
+		// inside strings, only track escapes + the closing quote
+		if (stream->string) {
+			if (json_buffer_add(stream->reading ? &stream->value : &stream->rest, c)) return 1;
+			if (stream->escape) stream->escape = 0;
+			else if (c == '\\') stream->escape = 1;
+			else if (c == '"') {
+				stream->string = 0;
+				if (stream->reading && stream->depth == 2 && json_stream_emit(stream)) return 1;
+				if (!stream->reading && stream->depth == 1) stream->key_end = stream->rest.length - 1;
+			}
+			continue;
+		}
+		// a scalar array value ends at the next separator
+		if (stream->reading && stream->depth == 2 && (c == ',' || c == ']' || is_space(c)) && json_stream_emit(stream)) return 1;
+		// between array values
+		if (stream->streaming && !stream->reading && stream->depth == 2) {
+			if (c == ',' || is_space(c)) continue;
+			if (c == ']') stream->streaming = 0;
+			else stream->reading = 1;
+		}
+		if (json_buffer_add(stream->reading ? &stream->value : &stream->rest, c)) return 1;
+		switch (c) {
+			case '"':
+				stream->string = 1;
+				if (!stream->reading && stream->depth == 1) stream->key_start = stream->rest.length;
+				break;
+			case '{': case '[':
+				// checking whether the array belongs to the streamed key
+				if (c == '[' && stream->depth == 1 && stream->key_end - stream->key_start == strlen(stream->key)
+				&& !strncmp(stream->rest.data + stream->key_start, stream->key, stream->key_end - stream->key_start))
+					stream->streaming = 1;
+				stream->depth++;
+				break;
+			case '}': case ']':
+				if (stream->depth) stream->depth--;
+				if (stream->reading && stream->depth == 2 && json_stream_emit(stream)) return 1;
+				break;
+		}
+	}
+	return 0;
+}
+
+const char* json_stream_rest(const struct JSONStream* stream) {
+	return stream->rest.data ? stream->rest.data : "";
+}
+
+void json_stream_destroy(struct JSONStream* stream) {
+	if (!stream) return;
+	free(stream->rest.data);
+	free(stream->value.data);
+	free(stream);
+}
+
+/* writer */
+
+struct JSONWriter {
+	int fd;
+	int comma; // whether the next value needs a comma before it
+	int error;
+	size_t length;
+	char buffer[WRITER_BUFFER_SIZE];
+};
+
+// writes out the buffer
+void json_writer_flush(struct JSONWriter* writer) {
+	for (size_t done = 0; done < writer->length && !writer->error;) {
+		ssize_t written = write(writer->fd, writer->buffer + done, writer->length - done);
+		if (written < 0) writer->error = 1;
+		else done += written;
+	}
+	writer->length = 0;
+}
+
+// appends `size` bytes to the buffer
+void json_writer_add(struct JSONWriter* writer, const char* data, size_t size) {
+	while (size) {
+		if (writer->length == WRITER_BUFFER_SIZE) json_writer_flush(writer);
+		size_t fit = WRITER_BUFFER_SIZE - writer->length;
+		if (fit > size) fit = size;
+		memcpy(writer->buffer + writer->length, data, fit);
+		writer->length += fit;
+		data += fit, size -= fit;
+	}
+}
+
+// adds a comma if the previous value needs one
+void json_writer_separate(struct JSONWriter* writer) {
+	if (writer->comma) json_writer_add(writer, ",", 1);
+	writer->comma = 1;
+}
+
+struct JSONWriter* json_writer_create(int fd) {
+	struct JSONWriter* writer = malloc(sizeof(struct JSONWriter));
+	if (!writer) return NULL;
+	writer->fd = fd;
+	writer->comma = writer->error = 0;
+	writer->length = 0;
+	return writer;
+}
+
+void json_writer_open(struct JSONWriter* writer, char bracket) {
+	json_writer_separate(writer);
+	json_writer_add(writer, &bracket, 1);
+	writer->comma = 0;
+}
+
+void json_writer_close(struct JSONWriter* writer, char bracket) {
+	json_writer_add(writer, &bracket, 1);
+	writer->comma = 1;
+}
+
+void json_writer_key(struct JSONWriter* writer, const char* key) {
+	json_writer_escaped(writer, key, strlen(key));
+	json_writer_add(writer, ":", 1);
+	writer->comma = 0;
+}
+
+void json_writer_string(struct JSONWriter* writer, const char* string, size_t length) {
+	json_writer_separate(writer);
+	json_writer_add(writer, "\"", 1);
+	const char* run = string; // characters that don't need escaping, written together
+	for (const char* end = string + length; string < end; string++) {
+		unsigned char c = *string;
+		if (c != '"' && c != '\\' && c >= 0x20) continue;
+		json_writer_add(writer, run, string - run);
+		char escape[7];
+		if (c == '"' || c == '\\') sprintf(escape, "\\%c", c);
+		else if (c == '\n') strcpy(escape, "\\n");
+		else if (c == '\t') strcpy(escape, "\\t");
+		else sprintf(escape, "\\u%04x", c);
+		json_writer_add(writer, escape, strlen(escape));
+		run = string + 1;
+	}
+	json_writer_add(writer, run, string - run);
+	json_writer_add(writer, "\"", 1);
+}
+
+void json_writer_escaped(struct JSONWriter* writer, const char* string, size_t length) {
+	json_writer_separate(writer);
+	json_writer_add(writer, "\"", 1);
+	json_writer_add(writer, string, length);
+	json_writer_add(writer, "\"", 1);
+}
+
+void json_writer_int(struct JSONWriter* writer, long long value) {
+	char string[24];
+	json_writer_separate(writer);
+	json_writer_add(writer, string, sprintf(string, "%lld", value));
+}
+
+void json_writer_bool(struct JSONWriter* writer, int value) {
+	json_writer_separate(writer);
+	if (value) json_writer_add(writer, "true", 4);
+	else json_writer_add(writer, "false", 5);
+}
+
+void json_writer_newline(struct JSONWriter* writer) {
+	json_writer_add(writer, "\n", 1);
+	writer->comma = 0;
+}
+
+int json_writer_destroy(struct JSONWriter* writer) {
+	json_writer_flush(writer);
+	int error = writer->error;
+	free(writer);
+	return error;
 }
\ No newline at end of file
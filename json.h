@@ -19,15 +19,18 @@ enum JSONType json_type(const char* json);
    an index contains a list of pointers into a source string
    each pointer points to a json value
 	 may break if the source string is ever modified
-	 must be freed after use */
+	 if built with an arena, it's released along with the arena. otherwise, it must be freed after use */
 
 struct JSONIndex;
+struct Arena;
 
-// returns an index of values in the array at `json`
-struct JSONIndex* json_index_array(const char* json);
+// returns an index of values in the array at `json`, which is empty if `json` isn't an array
+// `arena` may be null
+struct JSONIndex* json_index_array(const char* json, struct Arena* arena);
 
-// returns an index of keys and values in the object at `json`
-struct JSONIndex* json_index_object(const char* json);
+// returns an index of keys and values in the object at `json`, which is empty if `json` isn't an object
+// `arena` may be null
+struct JSONIndex* json_index_object(const char* json, struct Arena* arena);
 
 // returns the value at some position in an index
 // assumes the position is less than the index size
@@ -42,6 +45,31 @@ const char* json_index_pair(const struct JSONIndex* index, const char* key);
 // an object index's size includes both keys and values
 size_t json_index_size(const struct JSONIndex* index);
 
+/* binding functions
+   decodes an object straight into a struct, as described by a list of fields.
+   each field names a key, the type its value is decoded as, and the offset of the struct member it's written to.
+   values with a different type than expected are ignored, along with keys not in the list */
+
+enum JSONBinding {
+	BIND_STRING, // char*, copied without unescaping
+	BIND_INT, // int64_t
+	BIND_BOOL, // int
+	BIND_CUSTOM, // anything, decoded by a parse function
+};
+
+struct JSONField {
+	const char* key;
+	enum JSONBinding type;
+	size_t offset; // of the struct member, from offsetof
+	int(*parse)(const char* json, void* member); // for BIND_CUSTOM. returns 0 on success
+};
+
+// decodes the object at `json` into the struct at `out`, as described by `fieldc` fields (at most 32)
+// strings are allocated from `arena`
+// sets each bit of `*found` for the fields decoded, with the first field as the lowest bit
+// returns 0 on success, or 1 if memory couldn't be allocated
+int json_bind(const char* json, const struct JSONField* fields, size_t fieldc, void* out, struct Arena* arena, unsigned long* found);
+
 /* helper functions for retreiving values from a string
    `json` is assumed to point to a value of the relevant type
 	 for other types, use standard c functions */
@@ -50,4 +78,60 @@ size_t json_index_size(const struct JSONIndex* index);
 size_t json_string_length(const char* json);
 
 // returns the bool at `json` as 1 (true) or 0 (false)
-int json_bool(const char* json);
\ No newline at end of file
+int json_bool(const char* json);
+
+/* stream functions
+   a stream is fed a json object in chunks as it arrives,
+   and passes each value of the array at one of its keys to a callback as soon as the value is complete.
+   only one value is held in memory at a time. the rest of the object is kept, minus the array's values */
+
+struct JSONStream;
+
+// returns a stream that passes values in the array at `key` to `callback`
+// `callback` gets each value as its own null-terminated string, and returns nonzero to stop the stream
+struct JSONStream* json_stream_create(const char* key, int(*callback)(const char* json, void* data), void* data);
+
+// feeds the next `size` bytes of the object into a stream
+// returns 0 on success, or 1 if memory couldn't be allocated or the callback stopped the stream
+int json_stream_feed(struct JSONStream* stream, const char* chunk, size_t size);
+
+// returns the part of the object fed so far that wasn't passed to the callback
+// once the whole object is fed, it can be indexed like any other object
+const char* json_stream_rest(const struct JSONStream* stream);
+
+void json_stream_destroy(struct JSONStream* stream);
+
+/* writer functions
+   a writer builds compact json in one large buffer, which is written out to a file descriptor whenever it fills.
+   commas between values are added automatically. write errors are remembered until the writer is destroyed */
+
+struct JSONWriter;
+
+// returns a writer to `fd`, or null if memory couldn't be allocated
+struct JSONWriter* json_writer_create(int fd);
+
+// opens an object or array, where `bracket` is '{' or '['
+void json_writer_open(struct JSONWriter* writer, char bracket);
+
+// closes an object or array, where `bracket` is '}' or ']'
+void json_writer_close(struct JSONWriter* writer, char bracket);
+
+// writes the key of the next value in an object
+void json_writer_key(struct JSONWriter* writer, const char* key);
+
+// writes `length` bytes of `string` as a string, escaping it
+void json_writer_string(struct JSONWriter* writer, const char* string, size_t length);
+
+// writes `length` bytes of `string` as a string, where it's already escaped (eg. copied from a response)
+void json_writer_escaped(struct JSONWriter* writer, const char* string, size_t length);
+
+void json_writer_int(struct JSONWriter* writer, long long value);
+
+void json_writer_bool(struct JSONWriter* writer, int value);
+
+// ends a line, so each top-level value is on its own line
+void json_writer_newline(struct JSONWriter* writer);
+
+// flushes and destroys a writer
+// returns 0 if everything was written
+int json_writer_destroy(struct JSONWriter* writer);
\ No newline at end of file
@@ -0,0 +1,214 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "arena.h"
+#include "sha1.h"
+#include "listing.h"
+
+#define LISTING_MAGIC "neoclst1"
+#define LISTING_INITIAL_CAP 256
+#define RECORD_DIRECTORY 1
+#define RECORD_SHA1 2
+
+struct ListingHeader {
+	char magic[8];
+	int64_t fetched;
+	uint64_t count;
+	uint64_t strings_size; // size of the path table after the records
+};
+
+struct ListingRecord {
+	uint64_t path; // offset into the path table
+	int64_t size;
+	int64_t created;
+	int64_t time;
+	uint8_t flags;
+	uint8_t sha1[SHA1_LENGTH];
+};
+
+/* helpers */
+
+int listing_entry_sort(const void* a, const void* b) {
+	return strcmp(((const struct RemoteFile*)a)->path, ((const struct RemoteFile*)b)->path);
+}
+
+// returns the entry for `path`, or null if there is none
+struct RemoteFile* listing_find(struct Listing* listing, const char* path) {
+	size_t start = 0;
+	size_t end = listing->sorted;
+	while (start < end) {
+		size_t i = start + (end - start) / 2;
+		int cmp = strcmp(listing->files[i].path, path);
+		if (!cmp) return &listing->files[i];
+		if (cmp > 0) end = i;
+		else start = i + 1;
+	}
+	// entries added since the last sort
+	for (size_t i = listing->sorted; i < listing->count; i++)
+		if (!strcmp(listing->files[i].path, path)) return &listing->files[i];
+	return NULL;
+}
+
+// adds an entry with a copy of `length` bytes of `path`
+// returns the entry, or null if memory couldn't be allocated
+struct RemoteFile* listing_add_copy(struct Listing* listing, const char* path, size_t length) {
+	char* copy = arena_alloc(listing->arena, length + 1);
+	if (!copy) return NULL;
+	memcpy(copy, path, length);
+	copy[length] = 0;
+	struct RemoteFile file = {copy};
+	if (listing_add(listing, &file)) return NULL;
+	return &listing->files[listing->count - 1];
+}
+
+// checks that a mapped cache of `size` bytes is well formed
+// returns 0 if it is
+int listing_validate(const char* map, size_t size) {
+	const struct ListingHeader* header = (const struct ListingHeader*)map;
+	if (size < sizeof(struct ListingHeader) || memcmp(header->magic, LISTING_MAGIC, 8)) return 1;
+	if (header->count > (size - sizeof(struct ListingHeader)) / sizeof(struct ListingRecord)) return 1;
+	size_t strings = sizeof(struct ListingHeader) + header->count * sizeof(struct ListingRecord);
+	if (header->strings_size != size - strings || (header->count && map[size - 1])) return 1;
+	const struct ListingRecord* records = (const struct ListingRecord*)(map + sizeof(struct ListingHeader));
+	for (uint64_t i = 0; i < header->count; i++)
+		if (records[i].path >= header->strings_size) return 1;
+	return 0;
+}
+
+/* interface */
+
+int listing_create(struct Listing* listing) {
+	*listing = (struct Listing){0};
+	return !(listing->arena = arena_create());
+}
+
+int listing_load(struct Listing* listing, const char* path, long ttl) {
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) return 1;
+	struct stat statbuf;
+	void* map = MAP_FAILED;
+	if (!fstat(fd, &statbuf) && statbuf.st_size) map = mmap(NULL, statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) return 1;
+	size_t size = statbuf.st_size;
+	const struct ListingHeader* header = map;
+	if (listing_validate(map, size) || (ttl >= 0 && difftime(time(NULL), header->fetched) >= ttl)) {munmap(map, size); return 1;}
+	// reading records
+	struct RemoteFile* files = malloc((header->count ? header->count : 1) * sizeof(struct RemoteFile));
+	if (!files) {munmap(map, size); return 1;}
+	const struct ListingRecord* records = (const struct ListingRecord*)((char*)map + sizeof(struct ListingHeader));
+	char* strings = (char*)(records + header->count);
+	for (uint64_t i = 0; i < header->count; i++) {
+		struct RemoteFile* file = &files[i];
+		file->path = strings + records[i].path;
+		file->size = records[i].size;
+		file->created = records[i].created;
+		file->time = records[i].time;
+		file->is_directory = !!(records[i].flags & RECORD_DIRECTORY);
+		file->has_sha1 = !!(records[i].flags & RECORD_SHA1);
+		memcpy(file->sha1, records[i].sha1, SHA1_LENGTH);
+	}
+	free(listing->files);
+	listing->files = files;
+	listing->count = listing->cap = listing->sorted = header->count;
+	listing->fetched = header->fetched;
+	listing->map = map;
+	listing->map_size = size;
+	return 0;
+}
+
+int listing_add(struct Listing* listing, const struct RemoteFile* file) {
+	if (listing->count == listing->cap) {
+		size_t cap = listing->cap ? listing->cap * 2 : LISTING_INITIAL_CAP;
+		struct RemoteFile* files = realloc(listing->files, cap * sizeof(struct RemoteFile));
+		if (!files) return 1;
+		listing->files = files;
+		listing->cap = cap;
+	}
+	listing->files[listing->count++] = *file;
+	listing->dirty = 1;
+	return 0;
+}
+
+void listing_sort(struct Listing* listing) {
+	if (listing->sorted == listing->count) return;
+	qsort(listing->files, listing->count, sizeof(struct RemoteFile), listing_entry_sort);
+	listing->sorted = listing->count;
+}
+
+int listing_upload(struct Listing* listing, const char* path, int64_t size, time_t updated, const unsigned char sha1[SHA1_LENGTH]) {
+	// parent directories
+	for (const char* slash = strchr(path, '/'); slash; slash = strchr(slash + 1, '/')) {
+		char parent[slash - path + 1];
+		memcpy(parent, path, slash - path);
+		parent[slash - path] = 0;
+		struct RemoteFile* dir = listing_find(listing, parent);
+		if (!dir && !(dir = listing_add_copy(listing, path, slash - path))) return 1;
+		if (!dir->created) dir->created = updated;
+		dir->is_directory = 1;
+		dir->time = updated;
+	}
+	// file
+	struct RemoteFile* file = listing_find(listing, path);
+	if (!file && !(file = listing_add_copy(listing, path, strlen(path)))) return 1;
+	if (!file->created) file->created = updated;
+	file->time = updated;
+	file->size = size;
+	file->is_directory = 0;
+	file->has_sha1 = 1;
+	memcpy(file->sha1, sha1, SHA1_LENGTH);
+	listing->dirty = 1;
+	return 0;
+}
+
+void listing_delete(struct Listing* listing, const char* path) {
+	listing_sort(listing);
+	size_t length = strlen(path);
+	size_t kept = 0;
+	for (size_t i = 0; i < listing->count; i++) {
+		const char* entry = listing->files[i].path;
+		if (!strncmp(entry, path, length) && (!entry[length] || entry[length] == '/')) continue;
+		listing->files[kept++] = listing->files[i];
+	}
+	if (kept != listing->count) listing->dirty = 1;
+	listing->count = listing->sorted = kept;
+}
+
+int listing_save(struct Listing* listing, const char* path) {
+	if (!listing->dirty) return 0;
+	listing_sort(listing);
+	// writing to a temporary file first, so an interrupted save can't corrupt the cache
+	char tmp_path[strlen(path) + 5];
+	strcpy(tmp_path, path);
+	strcat(tmp_path, ".tmp");
+	FILE* file = fopen(tmp_path, "wb");
+	if (!file) return 1;
+	struct ListingHeader header = {LISTING_MAGIC, listing->fetched, listing->count, 0};
+	for (size_t i = 0; i < listing->count; i++) header.strings_size += strlen(listing->files[i].path) + 1;
+	fwrite(&header, sizeof(struct ListingHeader), 1, file);
+	uint64_t offset = 0;
+	for (size_t i = 0; i < listing->count; i++) {
+		const struct RemoteFile* entry = &listing->files[i];
+		struct ListingRecord record = {offset, entry->size, entry->created, entry->time};
+		record.flags = (entry->is_directory ? RECORD_DIRECTORY : 0) | (entry->has_sha1 ? RECORD_SHA1 : 0);
+		memcpy(record.sha1, entry->sha1, SHA1_LENGTH);
+		fwrite(&record, sizeof(struct ListingRecord), 1, file);
+		offset += strlen(entry->path) + 1;
+	}
+	for (size_t i = 0; i < listing->count; i++) fwrite(listing->files[i].path, strlen(listing->files[i].path) + 1, 1, file);
+	if (ferror(file) | fclose(file) || rename(tmp_path, path)) {remove(tmp_path); return 1;}
+	listing->dirty = 0;
+	return 0;
+}
+
+void listing_destroy(struct Listing* listing) {
+	free(listing->files);
+	arena_destroy(listing->arena);
+	if (listing->map) munmap(listing->map, listing->map_size);
+}
\ No newline at end of file
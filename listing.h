@@ -0,0 +1,64 @@
+/* remote listing cache
+   keeps the last fetched site listing in the site root, so commands run soon after can skip fetching it again.
+   commands that change remote files apply their changes to the cached listing, keeping it correct until it expires.
+   the cache is a binary file that's memory-mapped to be read:
+   a header, then a fixed-size record for each entry sorted by path, then the entries' null-terminated paths.
+   it's written in the machine's native byte order, as it's never shared */
+
+#define LISTING_PATH ".neoc_listing"
+
+// a file or directory from a remote listing
+struct RemoteFile {
+	char* path;
+	time_t created;
+	time_t time;
+	int64_t size;
+	int is_directory;
+	int has_sha1;
+	unsigned char sha1[SHA1_LENGTH];
+};
+
+// every entry in a remote listing
+struct Listing {
+	struct RemoteFile* files;
+	size_t count;
+	size_t cap;
+	size_t sorted; // entries before this position are sorted by path
+	time_t fetched; // when the listing was fetched from neocities
+	struct Arena* arena; // holds paths that aren't mapped from the cache
+	void* map; // the mapped cache, which holds the other paths
+	size_t map_size;
+	int dirty; // whether the listing has changed since it was loaded
+};
+
+// initializes an empty listing
+// returns 0 on success, or 1 if memory couldn't be allocated
+int listing_create(struct Listing* listing);
+
+// replaces the entries of an empty `listing` with those cached at `path`, if they were fetched less than `ttl` seconds ago
+// a negative `ttl` accepts a cache of any age
+// returns 0 if the cache was loaded, or 1 if it's missing, expired, invalid, or memory couldn't be allocated
+int listing_load(struct Listing* listing, const char* path, long ttl);
+
+// adds an entry without copying its path, which must last as long as the listing (ie. allocated from its arena)
+// returns 0 on success, or 1 if memory couldn't be allocated
+int listing_add(struct Listing* listing, const struct RemoteFile* file);
+
+// returns the entry for `path`, or null if there is none
+struct RemoteFile* listing_find(struct Listing* listing, const char* path);
+
+// sorts any entries added since the listing was last sorted
+void listing_sort(struct Listing* listing);
+
+// records a file uploaded to `path`, along with any directories it was put in
+// returns 0 on success, or 1 if memory couldn't be allocated
+int listing_upload(struct Listing* listing, const char* path, int64_t size, time_t updated, const unsigned char sha1[SHA1_LENGTH]);
+
+// records `path` being deleted, along with everything in it if it's a directory
+void listing_delete(struct Listing* listing, const char* path);
+
+// sorts the listing and writes it to `path` if it has changed since it was loaded
+// returns 0 on success
+int listing_save(struct Listing* listing, const char* path);
+
+void listing_destroy(struct Listing* listing);
\ No newline at end of file
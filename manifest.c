@@ -0,0 +1,227 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include "sha1.h"
+#include "pathtable.h"
+#include "timing.h"
+#include "manifest.h"
+
+#define MANIFEST_HEADER "neoc-manifest 1"
+#define MANIFEST_REALLOC_STEP 256
+
+struct ManifestEntry {
+	char* path;
+	unsigned long long size;
+	long long mtime;
+	unsigned long long inode;
+	unsigned char sha1[SHA1_LENGTH];
+	int fresh; // hashed during this run, so trusted regardless of when the manifest was written
+};
+
+struct Manifest {
+	struct ManifestEntry* entries;
+	size_t size;
+	size_t cap;
+	size_t sorted; // entries before this position are sorted by path
+	time_t written; // entries modified at or after this time may have changed unnoticed
+	int dirty;
+};
+
+/* helpers */
+
+int manifest_entry_sort(const void* a, const void* b) {
+	return strcmp(((const struct ManifestEntry*)a)->path, ((const struct ManifestEntry*)b)->path);
+}
+
+// returns the sorted entry for `path`, or null if there is none
+struct ManifestEntry* manifest_find(struct Manifest* manifest, const char* path) {
+	size_t start = 0;
+	size_t end = manifest->sorted;
+	while (start < end) {
+		size_t i = start + (end - start) / 2;
+		int cmp = strcmp(manifest->entries[i].path, path);
+		if (!cmp) return &manifest->entries[i];
+		if (cmp > 0) end = i;
+		else start = i + 1;
+	}
+	return NULL;
+}
+
+// appends a new entry for `path`. returns null on allocation failure
+struct ManifestEntry* manifest_append(struct Manifest* manifest, const char* path) {
+	if (manifest->size == manifest->cap) {
+		struct ManifestEntry* entries = realloc(manifest->entries, (manifest->cap + MANIFEST_REALLOC_STEP) * sizeof(struct ManifestEntry));
+		if (!entries) return NULL;
+		manifest->entries = entries;
+		manifest->cap += MANIFEST_REALLOC_STEP;
+	}
+	struct ManifestEntry* entry = &manifest->entries[manifest->size];
+	if (!(entry->path = strdup(path))) return NULL;
+	manifest->size++;
+	return entry;
+}
+
+// parses one manifest line into a new entry. returns 1 if the line is malformed
+int manifest_parse_line(struct Manifest* manifest, char* line) {
+	char* end;
+	unsigned char sha1[SHA1_LENGTH];
+	if (sha1_from_hex(line, sha1) || line[SHA1_LENGTH * 2] != ' ') return 1;
+	line += SHA1_LENGTH * 2;
+	unsigned long long size = strtoull(line, &end, 10);
+	if (end == line || *end != ' ') return 1;
+	long long mtime = strtoll(line = end, &end, 10);
+	if (end == line || *end != ' ') return 1;
+	unsigned long long inode = strtoull(line = end, &end, 10);
+	if (end == line || *end != ' ' || !end[1]) return 1;
+	struct ManifestEntry* entry = manifest_append(manifest, end + 1);
+	if (!entry) return 1;
+	entry->size = size;
+	entry->mtime = mtime;
+	entry->inode = inode;
+	memcpy(entry->sha1, sha1, SHA1_LENGTH);
+	entry->fresh = 0;
+	return 0;
+}
+
+// returns 1 if `entry` exists and its hash can be used for a file with `statbuf`
+int manifest_entry_current(struct Manifest* manifest, struct ManifestEntry* entry, const struct stat* statbuf) {
+	return entry && entry->size == (unsigned long long)statbuf->st_size && entry->mtime == statbuf->st_mtime
+		&& entry->inode == (unsigned long long)statbuf->st_ino && (entry->fresh || statbuf->st_mtime < manifest->written);
+}
+
+// stores the stat data and hash of the file at `path` in `entry`, or in a new entry if it's null
+// returns 1 if a new entry couldn't be allocated
+int manifest_entry_set(struct Manifest* manifest, struct ManifestEntry* entry, const char* path, const struct stat* statbuf, const unsigned char hash[SHA1_LENGTH]) {
+	if (!entry && !(entry = manifest_append(manifest, path))) return 1;
+	entry->size = statbuf->st_size;
+	entry->mtime = statbuf->st_mtime;
+	entry->inode = statbuf->st_ino;
+	memcpy(entry->sha1, hash, SHA1_LENGTH);
+	entry->fresh = 1;
+	manifest->dirty = 1;
+	return 0;
+}
+
+/* interface */
+
+struct Manifest* manifest_load(const char* path) {
+	struct Manifest* manifest = calloc(1, sizeof(struct Manifest));
+	if (!manifest) return NULL;
+	FILE* file = fopen(path, "r");
+	if (!file) return manifest;
+	// reading entries
+	char* line = NULL;
+	size_t line_cap = 0;
+	ssize_t length = getline(&line, &line_cap, file);
+	if (length > 0 && !strncmp(line, MANIFEST_HEADER" ", strlen(MANIFEST_HEADER) + 1)) {
+		manifest->written = strtoll(line + strlen(MANIFEST_HEADER) + 1, NULL, 10);
+		while ((length = getline(&line, &line_cap, file)) > 0) {
+			if (line[length - 1] == '\n') line[--length] = 0;
+			if (manifest_parse_line(manifest, line)) manifest->dirty = 1;
+		}
+	}
+	free(line);
+	fclose(file);
+	// entries are written sorted, but a hand-edited manifest might not be
+	qsort(manifest->entries, manifest->size, sizeof(struct ManifestEntry), manifest_entry_sort);
+	manifest->sorted = manifest->size;
+	return manifest;
+}
+
+void manifest_retain(struct Manifest* manifest, const struct PathTable* paths) {
+	char buffer[paths->max_length + 1];
+	struct PathCursor cursor;
+	path_cursor_start(&cursor, paths, 0, buffer);
+	const char* path = path_cursor_next(&cursor);
+	size_t kept = 0;
+	for (size_t i = 0; i < manifest->sorted; i++) {
+		struct ManifestEntry* entry = &manifest->entries[i];
+		while (path && strcmp(path, entry->path) < 0) path = path_cursor_next(&cursor);
+		if (path && !strcmp(path, entry->path)) manifest->entries[kept++] = *entry;
+		else {free(entry->path); manifest->dirty = 1;}
+	}
+	if (manifest->size > manifest->sorted)
+		memmove(manifest->entries + kept, manifest->entries + manifest->sorted, (manifest->size - manifest->sorted) * sizeof(struct ManifestEntry));
+	manifest->size -= manifest->sorted - kept;
+	manifest->sorted = kept;
+}
+
+int manifest_refresh(struct Manifest* manifest, size_t count, const char** paths) {
+	if (!count) return 0;
+	// picking out files whose cached hashes can't be used
+	const char** stale_paths = malloc(count * sizeof(char*));
+	struct stat* stats = malloc(count * sizeof(struct stat));
+	unsigned char (*hashes)[SHA1_LENGTH] = malloc(count * SHA1_LENGTH);
+	char* errors = malloc(count);
+	int error = 1;
+	if (!stale_paths || !stats || !hashes || !errors) goto cleanup;
+	size_t stale_count = 0;
+	unsigned long long bytes = 0;
+	for (size_t i = 0; i < count; i++) {
+		if (stat(paths[i], &stats[stale_count]) || manifest_entry_current(manifest, manifest_find(manifest, paths[i]), &stats[stale_count])) continue;
+		bytes += stats[stale_count].st_size;
+		stale_paths[stale_count++] = paths[i];
+	}
+	// hashing them all at once
+	double start = timing_now();
+	sha1_files(stale_count, stale_paths, hashes, errors);
+	timing_hashed(stale_count, bytes, timing_now() - start);
+	size_t sorted = manifest->size;
+	for (size_t i = 0; i < stale_count; i++)
+		if (!errors[i] && manifest_entry_set(manifest, manifest_find(manifest, stale_paths[i]), stale_paths[i], &stats[i], hashes[i])) goto cleanup;
+	// appended entries need sorting in before they can be found
+	if (manifest->size > sorted) {
+		qsort(manifest->entries, manifest->size, sizeof(struct ManifestEntry), manifest_entry_sort);
+		manifest->sorted = manifest->size;
+	}
+	error = 0;
+	cleanup:
+	free(stale_paths);
+	free(stats);
+	free(hashes);
+	free(errors);
+	return error;
+}
+
+int manifest_hash(struct Manifest* manifest, const char* path, const struct stat* statbuf, unsigned char hash[SHA1_LENGTH]) {
+	struct ManifestEntry* entry = manifest_find(manifest, path);
+	if (manifest_entry_current(manifest, entry, statbuf)) {
+		memcpy(hash, entry->sha1, SHA1_LENGTH);
+		return 0;
+	}
+	if (sha1_file(path, hash)) return 1;
+	manifest_entry_set(manifest, entry, path, statbuf, hash);
+	return 0;
+}
+
+int manifest_save(struct Manifest* manifest, const char* path) {
+	if (!manifest->dirty) return 0;
+	qsort(manifest->entries, manifest->size, sizeof(struct ManifestEntry), manifest_entry_sort);
+	manifest->sorted = manifest->size;
+	// writing to a temporary file first, so an interrupted save can't corrupt the manifest
+	char tmp_path[strlen(path) + 5];
+	strcpy(tmp_path, path);
+	strcat(tmp_path, ".tmp");
+	FILE* file = fopen(tmp_path, "w");
+	if (!file) return 1;
+	manifest->written = time(NULL);
+	fprintf(file, MANIFEST_HEADER" %lld\n", (long long)manifest->written);
+	for (size_t i = 0; i < manifest->size; i++) {
+		struct ManifestEntry* entry = &manifest->entries[i];
+		for (int j = 0; j < SHA1_LENGTH; j++) fprintf(file, "%02x", entry->sha1[j]);
+		fprintf(file, " %llu %lld %llu %s\n", entry->size, entry->mtime, entry->inode, entry->path);
+	}
+	if (fclose(file) || rename(tmp_path, path)) {remove(tmp_path); return 1;}
+	manifest->dirty = 0;
+	return 0;
+}
+
+void manifest_destroy(struct Manifest* manifest) {
+	if (!manifest) return;
+	for (size_t i = 0; i < manifest->size; i++) free(manifest->entries[i].path);
+	free(manifest->entries);
+	free(manifest);
+}
\ No newline at end of file
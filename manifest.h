@@ -0,0 +1,32 @@
+/* local file manifest
+   caches the sha1 of each local file alongside its stat data,
+   so files are only rehashed once they've changed.
+   the manifest is stored in the site root as a sorted text file */
+
+#define MANIFEST_PATH ".neoc_manifest"
+
+struct Manifest;
+struct PathTable;
+
+// loads the manifest at `path`. if the file doesn't exist, returns an empty manifest
+// returns null if memory couldn't be allocated
+struct Manifest* manifest_load(const char* path);
+
+// drops entries whose paths aren't in `paths`
+// should be called before any lookups
+void manifest_retain(struct Manifest* manifest, const struct PathTable* paths);
+
+// hashes the `count` files at `paths` in parallel where their cached entries are out of date,
+// so later calls to manifest_hash for them are lookups. files that can't be read are left for manifest_hash to report
+// returns 1 if memory couldn't be allocated
+int manifest_refresh(struct Manifest* manifest, size_t count, const char** paths);
+
+// writes the sha1 of the file at `path` to `hash`, rehashing the file only if `statbuf` differs from the cached entry
+// returns 0 on success, or 1 if the file couldn't be hashed
+int manifest_hash(struct Manifest* manifest, const char* path, const struct stat* statbuf, unsigned char hash[SHA1_LENGTH]);
+
+// writes the manifest to `path` if it has changed since it was loaded
+// returns 0 on success
+int manifest_save(struct Manifest* manifest, const char* path);
+
+void manifest_destroy(struct Manifest* manifest);
\ No newline at end of file
@@ -0,0 +1,167 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "walk.h"
+#include "pathtable.h"
+
+#define PATH_TABLE_BLOCK 16 // paths in each block. larger blocks save a little space, but make lookups decode more
+#define PATH_TABLE_INITIAL_SIZE 4096
+
+/* helpers */
+
+int path_sort(const void* a, const void* b) {
+	return strcmp(*(const char**)a, *(const char**)b);
+}
+
+// writes `value` to `data` 7 bits at a time, lowest first, with the top bit of each byte set if more follow
+// returns the number of bytes written, at most 10
+size_t varint_write(unsigned char* data, size_t value) {
+	size_t length = 0;
+	for (; value >= 0x80; value >>= 7) data[length++] = value | 0x80;
+	data[length++] = value;
+	return length;
+}
+
+// reads a value written by `varint_write` at `*data_p`, moving `*data_p` past it
+size_t varint_read(const unsigned char** data_p) {
+	const unsigned char* data = *data_p;
+	size_t value = 0;
+	for (int shift = 0;; shift += 7) {
+		value |= (size_t)(*data & 0x7f) << shift;
+		if (!(*data++ & 0x80)) break;
+	}
+	*data_p = data;
+	return value;
+}
+
+// decodes the path at `*data_p` into `path`, which holds the path before it, moving `*data_p` past it
+// returns the path's length
+size_t path_decode(const unsigned char** data_p, char* path) {
+	size_t prefix = varint_read(data_p);
+	size_t suffix = varint_read(data_p);
+	memcpy(path + prefix, *data_p, suffix);
+	path[prefix + suffix] = 0;
+	*data_p += suffix;
+	return prefix + suffix;
+}
+
+// compares `path` with the first path of `block`, which is stored in full
+int path_table_compare_block(const struct PathTable* table, size_t block, const char* path, size_t length) {
+	const unsigned char* data = table->data + table->blocks[block];
+	varint_read(&data);
+	size_t first_length = varint_read(&data);
+	int cmp = memcmp(data, path, first_length < length ? first_length : length);
+	if (cmp) return cmp;
+	return (first_length > length) - (first_length < length);
+}
+
+/* interface */
+
+int path_table_create(struct PathTable* table, struct PathList* list) {
+	*table = (struct PathTable){0};
+	if (list->count) qsort(list->paths, list->count, sizeof(char*), path_sort);
+	table->blocks = malloc((list->count / PATH_TABLE_BLOCK + 1) * sizeof(size_t));
+	size_t cap = PATH_TABLE_INITIAL_SIZE;
+	table->data = malloc(cap);
+	if (!table->blocks || !table->data) goto cleanup_table;
+	const char* previous = "";
+	size_t previous_length = 0;
+	for (size_t i = 0; i < list->count; i++) {
+		const char* path = list->paths[i];
+		size_t length = strlen(path);
+		if (i && length == previous_length && !memcmp(path, previous, length)) continue;
+		// sharing a prefix with the path before, unless this path starts a block
+		size_t prefix = 0;
+		if (table->count % PATH_TABLE_BLOCK) while (prefix < length && prefix < previous_length && path[prefix] == previous[prefix]) prefix++;
+		else table->blocks[table->count / PATH_TABLE_BLOCK] = table->size;
+		if (table->size + length - prefix + 20 > cap) {
+			while (table->size + length - prefix + 20 > cap) cap *= 2;
+			unsigned char* data = realloc(table->data, cap);
+			if (!data) goto cleanup_table;
+			table->data = data;
+		}
+		table->size += varint_write(table->data + table->size, prefix);
+		table->size += varint_write(table->data + table->size, length - prefix);
+		memcpy(table->data + table->size, path + prefix, length - prefix);
+		table->size += length - prefix;
+		if (length > table->max_length) table->max_length = length;
+		table->count++;
+		previous = path;
+		previous_length = length;
+	}
+	// giving back what the doubling overshot
+	unsigned char* data = realloc(table->data, table->size ? table->size : 1);
+	if (data) table->data = data;
+	return 0;
+	cleanup_table: path_table_destroy(table);
+	return 1;
+}
+
+int path_table_stat(struct PathTable* table) {
+	table->times = malloc((table->count + 1) * sizeof(time_t));
+	table->sizes = malloc((table->count + 1) * sizeof(int64_t));
+	if (!table->times || !table->sizes) return 1;
+	char buffer[table->max_length + 1];
+	struct PathCursor cursor;
+	path_cursor_start(&cursor, table, 0, buffer);
+	const char* path;
+	struct stat statbuf;
+	for (size_t i = 0; (path = path_cursor_next(&cursor)); i++) {
+		int error = stat(path, &statbuf);
+		table->times[i] = error ? 0 : statbuf.st_mtime;
+		table->sizes[i] = error ? -1 : statbuf.st_size;
+	}
+	return 0;
+}
+
+size_t path_table_find(const struct PathTable* table, const char* path) {
+	if (!table->count) return SIZE_MAX;
+	size_t length = strlen(path);
+	// finding the last block starting at or before `path`
+	size_t start = 0;
+	size_t end = (table->count - 1) / PATH_TABLE_BLOCK + 1;
+	while (end - start > 1) {
+		size_t i = start + (end - start) / 2;
+		if (path_table_compare_block(table, i, path, length) > 0) end = i;
+		else start = i;
+	}
+	// scanning the block
+	char buffer[table->max_length + 1];
+	struct PathCursor cursor;
+	path_cursor_start(&cursor, table, start * PATH_TABLE_BLOCK, buffer);
+	for (size_t i = 0; i < PATH_TABLE_BLOCK; i++) {
+		const char* entry = path_cursor_next(&cursor);
+		if (!entry) break;
+		int cmp = strcmp(entry, path);
+		if (!cmp) return cursor.index - 1;
+		if (cmp > 0) break;
+	}
+	return SIZE_MAX;
+}
+
+void path_table_destroy(struct PathTable* table) {
+	free(table->data);
+	free(table->blocks);
+	free(table->times);
+	free(table->sizes);
+}
+
+void path_cursor_start(struct PathCursor* cursor, const struct PathTable* table, size_t index, char* buffer) {
+	cursor->table = table;
+	cursor->path = buffer;
+	*buffer = 0;
+	if (index >= table->count) {cursor->index = table->count; return;}
+	// decoding from the start of the block, as each path builds on the one before
+	cursor->index = index - index % PATH_TABLE_BLOCK;
+	cursor->next = table->data + table->blocks[index / PATH_TABLE_BLOCK];
+	while (cursor->index < index) path_cursor_next(cursor);
+}
+
+const char* path_cursor_next(struct PathCursor* cursor) {
+	if (cursor->index >= cursor->table->count) return NULL;
+	path_decode(&cursor->next, cursor->path);
+	cursor->index++;
+	return cursor->path;
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+/* path tables
+   a sorted set of paths stored compactly, for trees too big to keep every path whole.
+   paths are grouped into blocks, laid out back to back in one buffer. the first path of a block is stored in full,
+   and each path after it as the length of the prefix it shares with the path before, then the bytes that differ.
+   metadata about each path is kept in separate columns, indexed by the path's position.
+   paths are found by binary searching the blocks' first paths, and read in order with a cursor */
+
+struct PathList;
+
+struct PathTable {
+	unsigned char* data; // the encoded blocks
+	size_t size;
+	size_t* blocks; // offset of each block in `data`
+	size_t count; // paths in the table
+	size_t max_length; // of the longest path
+	// columns, null until filled
+	time_t* times; // last modification times
+	int64_t* sizes; // sizes in bytes, or -1 for files that couldn't be found
+};
+
+// reads paths in order, decoding each into a buffer of the cursor's own
+struct PathCursor {
+	const struct PathTable* table;
+	size_t index; // of the next path
+	const unsigned char* next; // where the next path is encoded
+	char* path; // the current path
+};
+
+// fills `table` with the paths in `list`, sorted and without duplicates. `list` is sorted too
+// returns 0 on success, or 1 if memory couldn't be allocated
+int path_table_create(struct PathTable* table, struct PathList* list);
+
+// fills the `times` and `sizes` columns by stat-ing each path
+// returns 0 on success, or 1 if memory couldn't be allocated
+int path_table_stat(struct PathTable* table);
+
+// returns the position of `path`, or SIZE_MAX if it isn't in the table
+size_t path_table_find(const struct PathTable* table, const char* path);
+
+void path_table_destroy(struct PathTable* table);
+
+// starts `cursor` before the path at `index`, decoding paths into `buffer`, which must hold `table->max_length + 1` bytes
+void path_cursor_start(struct PathCursor* cursor, const struct PathTable* table, size_t index, char* buffer);
+
+// moves `cursor` to the next path and returns it, or null if there are none left
+// the path is only valid until the cursor moves again. its position is `cursor->index - 1`
+const char* path_cursor_next(struct PathCursor* cursor);
\ No newline at end of file
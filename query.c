@@ -0,0 +1,256 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <time.h>
+#include <fnmatch.h>
+#include "sha1.h"
+#include "listing.h"
+#include "query.h"
+
+const char* query_field_names[QUERY_FIELD_COUNT] = {"path", "size", "files", "updated", "created"};
+
+// the query being sorted by `query_result_sort`, as qsort takes no context
+const struct Query* query_sorting;
+
+/* helpers */
+
+// returns the field called `name` (`length` characters long), or QUERY_FIELD_COUNT if there's none
+enum QueryField query_field_find(const char* name, size_t length) {
+	enum QueryField field = 0;
+	for (; field < QUERY_FIELD_COUNT; field++)
+		if (strlen(query_field_names[field]) == length && !strncmp(query_field_names[field], name, length)) break;
+	return field;
+}
+
+// reads a non-negative integer taking up all of `string`. returns 0 on success
+int query_parse_count(const char* string, long long* count) {
+	char* end;
+	if (*string < '0' || *string > '9') return 1;
+	*count = strtoll(string, &end, 10);
+	return *end != 0;
+}
+
+// reads the value of a comparison with `field` into the range of values it stands for, from `low` to `high`
+// a date without a time stands for the whole day
+// returns 0 on success
+int query_parse_value(enum QueryField field, const char* string, long long* low, long long* high) {
+	if (field == QUERY_SIZE) {
+		char* end;
+		if (*string < '0' || *string > '9') return 1;
+		*low = strtoll(string, &end, 10);
+		const char* units = "kmg";
+		const char* unit = *end ? strchr(units, *end | 0x20) : NULL;
+		if (unit) *low <<= 10 * (unit - units + 1), end++;
+		*high = *low;
+		return *end != 0;
+	}
+	if (field == QUERY_COUNT) {
+		if (query_parse_count(string, low)) return 1;
+		*high = *low;
+		return 0;
+	}
+	// dates
+	struct tm date = {0};
+	int length = 0;
+	if (sscanf(string, "%4d-%2d-%2d%n", &date.tm_year, &date.tm_mon, &date.tm_mday, &length) != 3) return 1;
+	date.tm_year -= 1900;
+	date.tm_mon--;
+	long long span = 86400;
+	if (string[length]) {
+		int time_length = 0;
+		if ((string[length] | 0x20) != 't' || sscanf(string + length + 1, "%2d:%2d:%2d%n", &date.tm_hour, &date.tm_min, &date.tm_sec, &time_length) != 3) return 1;
+		length += time_length + 1;
+		span = 1;
+	}
+	if (string[length]) return 1;
+	*low = timegm(&date);
+	*high = *low + span - 1;
+	return 0;
+}
+
+// parses one query term. returns 0 on success
+int query_parse_term(struct Query* query, const char* term) {
+	if (!strcmp(term, "files")) query->kind = QUERY_FILES;
+	else if (!strcmp(term, "dirs")) query->kind = QUERY_DIRS;
+	else if (!strcmp(term, "du")) query->du = 1;
+	else if (!strncmp(term, "name=", 5) && term[5]) query->name = term + 5;
+	else if (!strncmp(term, "depth=", 6)) {
+		long long depth;
+		if (query_parse_count(term + 6, &depth)) return 1;
+		query->depth = depth;
+	}
+	else if (!strncmp(term, "limit=", 6)) {
+		long long limit;
+		if (query_parse_count(term + 6, &limit) || !limit) return 1;
+		query->limit = limit;
+	}
+	else if (!strncmp(term, "sort=", 5)) {
+		const char* name = term + 5;
+		query->descending = *name == '-';
+		name += query->descending;
+		if ((query->sort = query_field_find(name, strlen(name))) == QUERY_FIELD_COUNT) return 1;
+	}
+	else {
+		// comparisons
+		size_t length = strcspn(term, "<=>");
+		enum QueryField field = query_field_find(term, length);
+		if (!term[length] || field == QUERY_FIELD_COUNT || field == QUERY_PATH) return 1;
+		const char* op = term + length;
+		int or_equal = op[0] != '=' && op[1] == '=';
+		long long low, high;
+		if (query_parse_value(field, op + 1 + or_equal, &low, &high)) return 1;
+		// narrowing the field's bounds
+		long long min = LLONG_MIN;
+		long long max = LLONG_MAX;
+		if (*op == '<') max = or_equal ? high : low - 1;
+		else if (*op == '>') min = or_equal ? low : high + 1;
+		else min = low, max = high;
+		if (min > query->min[field]) query->min[field] = min;
+		if (max < query->max[field]) query->max[field] = max;
+	}
+	return 0;
+}
+
+// returns the index of the entry with the `length`-character `path` in `listing`, or SIZE_MAX if there's none
+size_t query_find(const struct Listing* listing, const char* path, size_t length) {
+	size_t start = 0;
+	size_t end = listing->count;
+	while (start < end) {
+		size_t i = start + (end - start) / 2;
+		const char* entry = listing->files[i].path;
+		int cmp = strncmp(entry, path, length);
+		if (!cmp && entry[length]) cmp = 1;
+		if (!cmp) return i;
+		if (cmp > 0) end = i;
+		else start = i + 1;
+	}
+	return SIZE_MAX;
+}
+
+long long query_result_field(const struct QueryResult* result, enum QueryField field) {
+	if (field == QUERY_SIZE) return result->size;
+	if (field == QUERY_COUNT) return result->count;
+	if (field == QUERY_UPDATED) return result->updated;
+	if (field == QUERY_CREATED) return result->file ? result->file->created : 0;
+	return 0;
+}
+
+int query_result_sort(const void* a, const void* b) {
+	const struct QueryResult* result_a = a;
+	const struct QueryResult* result_b = b;
+	long long field_a = query_result_field(result_a, query_sorting->sort);
+	long long field_b = query_result_field(result_b, query_sorting->sort);
+	int cmp = (field_a > field_b) - (field_a < field_b);
+	if (!cmp) cmp = strcmp(result_a->file ? result_a->file->path : "", result_b->file ? result_b->file->path : "");
+	return query_sorting->descending ? -cmp : cmp;
+}
+
+// returns 1 if `result`, `depth` levels beneath the query's path, passes the query's filters
+int query_matches(const struct Query* query, const struct QueryResult* result, long depth) {
+	int is_directory = !result->file || result->file->is_directory;
+	if (query->du ? !is_directory : query->kind != QUERY_ALL && (query->kind == QUERY_DIRS) != is_directory) return 0;
+	if (query->depth >= 0 && depth > query->depth) return 0;
+	for (enum QueryField field = QUERY_SIZE; field < QUERY_FIELD_COUNT; field++) {
+		long long value = query_result_field(result, field);
+		if (value < query->min[field] || value > query->max[field]) return 0;
+	}
+	if (query->name) {
+		if (!result->file) return 0;
+		const char* name = strrchr(result->file->path, '/');
+		if (fnmatch(query->name, name ? name + 1 : result->file->path, 0)) return 0;
+	}
+	return 1;
+}
+
+/* interface */
+
+const char* query_parse(struct Query* query, size_t argc, const char** args) {
+	*query = (struct Query){"", 0, QUERY_ALL};
+	for (enum QueryField field = 0; field < QUERY_FIELD_COUNT; field++) {
+		query->min[field] = LLONG_MIN;
+		query->max[field] = LLONG_MAX;
+	}
+	query->depth = -1;
+	for (size_t i = 0; i < argc; i++) {
+		const char* arg = args[i];
+		size_t length = strlen(arg);
+		// terms are parsed into a copy, so a failed one leaves no trace
+		struct Query term_query = *query;
+		if ((!length || arg[length - 1] != '/') && !query_parse_term(&term_query, arg)) {
+			*query = term_query;
+			query->terms++;
+			continue;
+		}
+		// the first argument may instead be the path. a trailing slash marks a path that looks like a term
+		if (i || (arg[strcspn(arg, "<=>")] && arg[length - 1] != '/')) return arg;
+		while (*arg == '/') arg++, length--;
+		while (length && arg[length - 1] == '/') length--;
+		query->path = arg;
+		query->path_length = length;
+	}
+	return NULL;
+}
+
+int query_run(const struct Query* query, const struct Listing* listing, struct QueryResult** results_p, size_t* count_p) {
+	size_t count = listing->count;
+	const struct RemoteFile* files = listing->files;
+	struct QueryResult* rollups = malloc((count + 1) * sizeof(struct QueryResult));
+	size_t* parents = malloc((count + 1) * sizeof(size_t));
+	struct QueryResult* results = malloc((count + 1) * sizeof(struct QueryResult));
+	if (!rollups || !parents || !results) {free(rollups); free(parents); free(results); return 1;}
+	// building the tree, where each entry's parent is the directory holding it (or SIZE_MAX at the root)
+	for (size_t i = 0; i < count; i++) {
+		const struct RemoteFile* file = &files[i];
+		rollups[i] = (struct QueryResult){file, file->is_directory ? 0 : file->size, !file->is_directory, file->is_directory ? 0 : file->time};
+		const char* slash = strrchr(file->path, '/');
+		parents[i] = slash ? query_find(listing, file->path, slash - file->path) : SIZE_MAX;
+	}
+	// rolling up totals. entries sort after the directories holding them, so going backwards totals each directory before it's added to its own
+	for (size_t i = count; i--;) {
+		struct QueryResult* rollup = &rollups[i];
+		if (!rollup->count) {rollup->updated = files[i].time; continue;}
+		if (parents[i] == SIZE_MAX) continue;
+		struct QueryResult* parent = &rollups[parents[i]];
+		parent->size += rollup->size;
+		parent->count += rollup->count;
+		if (rollup->updated > parent->updated) parent->updated = rollup->updated;
+	}
+	// picking out entries beneath the path, and totalling the files beneath it
+	size_t path_length = query->path_length;
+	size_t base = path_length ? query_find(listing, query->path, path_length) : SIZE_MAX;
+	int base_is_file = base != SIZE_MAX && !files[base].is_directory;
+	struct QueryResult total = {base == SIZE_MAX ? NULL : &files[base]};
+	size_t result_count = 0;
+	for (size_t i = 0; i < count; i++) {
+		const char* path = files[i].path;
+		if (path_length && (strncmp(path, query->path, path_length) || path[path_length] != '/') && i != base) continue;
+		long depth = 0;
+		if (i != base) {
+			const char* relative = path_length ? path + path_length + 1 : path;
+			for (depth = 1; *relative; relative++) depth += *relative == '/';
+			if (!files[i].is_directory) {
+				total.size += files[i].size;
+				total.count++;
+				if (files[i].time > total.updated) total.updated = files[i].time;
+			}
+		}
+		// the path itself is only listed if it's a file. du adds it below
+		if ((i != base || (base_is_file && !query->du)) && query_matches(query, &rollups[i], depth)) results[result_count++] = rollups[i];
+	}
+	if (query->du) {
+		if (base_is_file) total = rollups[base];
+		else if (!total.count && total.file) total.updated = total.file->time;
+		if (query_matches(query, &total, 0)) results[result_count++] = total;
+	}
+	free(rollups);
+	free(parents);
+	// ordering + limiting
+	query_sorting = query;
+	qsort(results, result_count, sizeof(struct QueryResult), query_result_sort);
+	if (query->limit && result_count > query->limit) result_count = query->limit;
+	*results_p = results;
+	*count_p = result_count;
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,61 @@
+/* listing queries
+   answer questions about the remote file tree from one listing, without further requests.
+   a query is a list of terms, each narrowing, ordering or summarizing the entries beneath a path:
+     `files` or `dirs` keeps only that kind of entry
+     `size`, `files`, `updated` or `created`, then `<`, `<=`, `=`, `>=` or `>`, then a value compares an entry's field.
+       sizes take k, m or g suffixes (powers of 1024), and dates are yyyy-mm-dd, optionally followed by thh:mm:ss (utc)
+     `name=[glob]` matches the last segment of an entry's path
+     `depth=[n]` keeps entries at most `n` levels beneath the path
+     `sort=[field]` orders entries by path, size, files, updated or created. a leading `-` reverses the order
+     `limit=[n]` keeps only the first `n` entries
+     `du` lists directories instead of entries, with the totals of the files beneath them, starting with the path itself
+   a directory's size, file count and update time are the total size, count and latest update time of the files beneath it */
+
+struct Listing;
+struct RemoteFile;
+
+enum QueryKind {
+	QUERY_ALL,
+	QUERY_FILES,
+	QUERY_DIRS
+};
+
+enum QueryField {
+	QUERY_PATH,
+	QUERY_SIZE,
+	QUERY_COUNT,
+	QUERY_UPDATED,
+	QUERY_CREATED,
+	QUERY_FIELD_COUNT
+};
+
+struct Query {
+	const char* path; // without leading slashes. empty for the site root
+	size_t path_length; // leaving out any trailing slashes
+	size_t terms; // how many terms were given, besides the path
+	enum QueryKind kind;
+	long long min[QUERY_FIELD_COUNT]; // bounds on each numeric field, inclusive
+	long long max[QUERY_FIELD_COUNT];
+	const char* name; // null to match any name
+	long depth; // negative for any depth
+	enum QueryField sort;
+	int descending;
+	size_t limit; // 0 for no limit
+	int du;
+};
+
+// an entry answering a query
+struct QueryResult {
+	const struct RemoteFile* file; // null for the du total of a path that isn't in the listing, like the site root
+	long long size;
+	long long count;
+	time_t updated;
+};
+
+// parses a path (which may be absent) followed by query terms from `args` into `query`
+// returns null on success, or the argument that couldn't be parsed
+const char* query_parse(struct Query* query, size_t argc, const char** args);
+
+// answers `query` from `listing`, which must be sorted, in `results`, which must be freed
+// returns 0 on success, or 1 if memory couldn't be allocated
+int query_run(const struct Query* query, const struct Listing* listing, struct QueryResult** results, size_t* count);
\ No newline at end of file
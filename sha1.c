@@ -0,0 +1,281 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <cpuid.h>
+#include <immintrin.h>
+#define SHA1_X86
+#elif defined(__aarch64__) && defined(__linux__) && defined(__GNUC__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#include <arm_neon.h>
+#define SHA1_ARM
+#endif
+#include "sha1.h"
+
+#define SHA1_BLOCK 64
+#define FILE_BUFFER_SIZE 65536
+#define FILE_MAP_MIN 262144 // files at least this big are mapped rather than read
+#define SHA1_THREADS 8
+
+struct SHA1 {
+	uint32_t state[5];
+	uint64_t length;
+	size_t buffered;
+	unsigned char buffer[SHA1_BLOCK];
+};
+
+/* block transforms
+   each hashes `blocks` 64-byte blocks at `data` into `state`.
+   the fastest one the cpu supports is picked the first time anything is hashed */
+
+#define ROTL(x, n) ((x) << (n) | (x) >> (32 - (n)))
+
+void sha1_transform(uint32_t state[5], const unsigned char* block) {
+	uint32_t w[80];
+	for (int i = 0; i < 16; i++)
+		w[i] = (uint32_t)block[i * 4] << 24 | block[i * 4 + 1] << 16 | block[i * 4 + 2] << 8 | block[i * 4 + 3];
+	for (int i = 16; i < 80; i++)
+		w[i] = ROTL(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+	uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+	for (int i = 0; i < 80; i++) {
+		uint32_t f, k;
+		if (i < 20) f = (b & c) | (~b & d), k = 0x5a827999;
+		else if (i < 40) f = b ^ c ^ d, k = 0x6ed9eba1;
+		else if (i < 60) f = (b & c) | (b & d) | (c & d), k = 0x8f1bbcdc;
+		else f = b ^ c ^ d, k = 0xca62c1d6;
+		uint32_t tmp = ROTL(a, 5) + f + e + k + w[i];
+		e = d, d = c, c = ROTL(b, 30), b = a, a = tmp;
+	}
+	state[0] += a, state[1] += b, state[2] += c, state[3] += d, state[4] += e;
+}
+
+void sha1_blocks_portable(uint32_t state[5], const unsigned char* data, size_t blocks) {
+	for (; blocks--; data += SHA1_BLOCK) sha1_transform(state, data);
+}
+
+#ifdef SHA1_X86
+
+// four rounds with sha-ni, `g` being the round group (0-19). message words are expanded 4 at a time in `msg`,
+// and `e` alternates between holding the next group's e and the current abcd
+#define SHANI_ROUNDS(g) \
+	if ((g) < 4) msg[g] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + (g) * 16)), mask); \
+	if (!(g)) e[0] = _mm_add_epi32(e[0], msg[0]); \
+	else e[(g) % 2] = _mm_sha1nexte_epu32(e[(g) % 2], msg[(g) % 4]); \
+	e[((g) + 1) % 2] = abcd; \
+	if ((g) >= 3 && (g) <= 18) msg[((g) + 1) % 4] = _mm_sha1msg2_epu32(msg[((g) + 1) % 4], msg[(g) % 4]); \
+	abcd = _mm_sha1rnds4_epu32(abcd, e[(g) % 2], (g) / 5); \
+	if ((g) >= 1 && (g) <= 16) msg[((g) + 3) % 4] = _mm_sha1msg1_epu32(msg[((g) + 3) % 4], msg[(g) % 4]); \
+	if ((g) >= 2 && (g) <= 17) msg[((g) + 2) % 4] = _mm_xor_si128(msg[((g) + 2) % 4], msg[(g) % 4]);
+
+__attribute__((target("sha,sse4.1")))
+void sha1_blocks_shani(uint32_t state[5], const unsigned char* data, size_t blocks) {
+	const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+	__m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)state), 0x1b);
+	__m128i e_state = _mm_set_epi32(state[4], 0, 0, 0);
+	for (; blocks--; data += SHA1_BLOCK) {
+		__m128i abcd_start = abcd;
+		__m128i e[2] = {e_state};
+		__m128i msg[4];
+		SHANI_ROUNDS(0) SHANI_ROUNDS(1) SHANI_ROUNDS(2) SHANI_ROUNDS(3) SHANI_ROUNDS(4)
+		SHANI_ROUNDS(5) SHANI_ROUNDS(6) SHANI_ROUNDS(7) SHANI_ROUNDS(8) SHANI_ROUNDS(9)
+		SHANI_ROUNDS(10) SHANI_ROUNDS(11) SHANI_ROUNDS(12) SHANI_ROUNDS(13) SHANI_ROUNDS(14)
+		SHANI_ROUNDS(15) SHANI_ROUNDS(16) SHANI_ROUNDS(17) SHANI_ROUNDS(18) SHANI_ROUNDS(19)
+		e_state = _mm_sha1nexte_epu32(e[0], e_state);
+		abcd = _mm_add_epi32(abcd, abcd_start);
+	}
+	_mm_storeu_si128((__m128i*)state, _mm_shuffle_epi32(abcd, 0x1b));
+	state[4] = _mm_extract_epi32(e_state, 3);
+}
+
+// returns whether the cpu has sha-ni, along with the sse it needs
+int sha1_shani_supported(void) {
+	unsigned a, b, c, d;
+	if (!__get_cpuid(1, &a, &b, &c, &d) || !(c & bit_SSE4_1) || !(c & bit_SSSE3)) return 0;
+	return __get_cpuid_count(7, 0, &a, &b, &c, &d) && b & 1 << 29;
+}
+
+#endif
+
+#ifdef SHA1_ARM
+
+// four rounds with the armv8 sha1 instructions, `g` being the round group (0-19). message words are expanded 4 at a time in `msg`,
+// `sum` holds the next two groups' words plus their constant, and `e` alternates between the current and next group's e
+#define ARM_ROUNDS(g, op) \
+	e[((g) + 1) % 2] = vsha1h_u32(vgetq_lane_u32(abcd, 0)); \
+	abcd = op(abcd, e[(g) % 2], sum[(g) % 2]); \
+	if ((g) <= 17) sum[(g) % 2] = vaddq_u32(msg[((g) + 2) % 4], vdupq_n_u32(k[((g) + 2) / 5])); \
+	if ((g) >= 1 && (g) <= 16) msg[((g) + 3) % 4] = vsha1su1q_u32(msg[((g) + 3) % 4], msg[((g) + 2) % 4]); \
+	if ((g) <= 15) msg[(g) % 4] = vsha1su0q_u32(msg[(g) % 4], msg[((g) + 1) % 4], msg[((g) + 2) % 4]);
+
+__attribute__((target("+crypto")))
+void sha1_blocks_arm(uint32_t state[5], const unsigned char* data, size_t blocks) {
+	static const uint32_t k[4] = {0x5a827999, 0x6ed9eba1, 0x8f1bbcdc, 0xca62c1d6};
+	uint32x4_t abcd = vld1q_u32(state);
+	uint32_t e_state = state[4];
+	for (; blocks--; data += SHA1_BLOCK) {
+		uint32x4_t abcd_start = abcd;
+		uint32_t e[2] = {e_state};
+		uint32x4_t msg[4];
+		for (int i = 0; i < 4; i++) msg[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + i * 16)));
+		uint32x4_t sum[2] = {vaddq_u32(msg[0], vdupq_n_u32(k[0])), vaddq_u32(msg[1], vdupq_n_u32(k[0]))};
+		ARM_ROUNDS(0, vsha1cq_u32) ARM_ROUNDS(1, vsha1cq_u32) ARM_ROUNDS(2, vsha1cq_u32) ARM_ROUNDS(3, vsha1cq_u32) ARM_ROUNDS(4, vsha1cq_u32)
+		ARM_ROUNDS(5, vsha1pq_u32) ARM_ROUNDS(6, vsha1pq_u32) ARM_ROUNDS(7, vsha1pq_u32) ARM_ROUNDS(8, vsha1pq_u32) ARM_ROUNDS(9, vsha1pq_u32)
+		ARM_ROUNDS(10, vsha1mq_u32) ARM_ROUNDS(11, vsha1mq_u32) ARM_ROUNDS(12, vsha1mq_u32) ARM_ROUNDS(13, vsha1mq_u32) ARM_ROUNDS(14, vsha1mq_u32)
+		ARM_ROUNDS(15, vsha1pq_u32) ARM_ROUNDS(16, vsha1pq_u32) ARM_ROUNDS(17, vsha1pq_u32) ARM_ROUNDS(18, vsha1pq_u32) ARM_ROUNDS(19, vsha1pq_u32)
+		e_state = e[0] + e_state;
+		abcd = vaddq_u32(abcd, abcd_start);
+	}
+	vst1q_u32(state, abcd);
+	state[4] = e_state;
+}
+
+#endif
+
+void(*sha1_blocks)(uint32_t state[5], const unsigned char* data, size_t blocks) = sha1_blocks_portable;
+pthread_once_t sha1_blocks_once = PTHREAD_ONCE_INIT;
+
+void sha1_blocks_pick(void) {
+#ifdef SHA1_X86
+	if (sha1_shani_supported()) sha1_blocks = sha1_blocks_shani;
+#endif
+#ifdef SHA1_ARM
+	if (getauxval(AT_HWCAP) & HWCAP_SHA1) sha1_blocks = sha1_blocks_arm;
+#endif
+}
+
+/* streaming */
+
+void sha1_init(struct SHA1* sha) {
+	pthread_once(&sha1_blocks_once, sha1_blocks_pick);
+	sha->state[0] = 0x67452301;
+	sha->state[1] = 0xefcdab89;
+	sha->state[2] = 0x98badcfe;
+	sha->state[3] = 0x10325476;
+	sha->state[4] = 0xc3d2e1f0;
+	sha->length = 0;
+	sha->buffered = 0;
+}
+
+void sha1_update(struct SHA1* sha, const unsigned char* data, size_t size) {
+	sha->length += size;
+	if (sha->buffered) {
+		size_t fill = SHA1_BLOCK - sha->buffered;
+		if (fill > size) fill = size;
+		memcpy(sha->buffer + sha->buffered, data, fill);
+		sha->buffered += fill, data += fill, size -= fill;
+		if (sha->buffered < SHA1_BLOCK) return;
+		sha1_blocks(sha->state, sha->buffer, 1);
+		sha->buffered = 0;
+	}
+	sha1_blocks(sha->state, data, size / SHA1_BLOCK);
+	data += size - size % SHA1_BLOCK;
+	size %= SHA1_BLOCK;
+	memcpy(sha->buffer, data, size);
+	sha->buffered = size;
+}
+
+void sha1_final(struct SHA1* sha, unsigned char hash[SHA1_LENGTH]) {
+	uint64_t bits = sha->length * 8;
+	unsigned char pad[SHA1_BLOCK + 8] = {0x80};
+	size_t pad_size = (sha->buffered < 56 ? 56 : 120) - sha->buffered;
+	for (int i = 0; i < 8; i++) pad[pad_size + i] = bits >> (56 - i * 8);
+	sha1_update(sha, pad, pad_size + 8);
+	for (int i = 0; i < SHA1_LENGTH; i++) hash[i] = sha->state[i / 4] >> (24 - i % 4 * 8);
+}
+
+/* interface */
+
+void sha1_data(const void* data, size_t size, unsigned char hash[SHA1_LENGTH]) {
+	struct SHA1 sha;
+	sha1_init(&sha);
+	sha1_update(&sha, data, size);
+	sha1_final(&sha, hash);
+}
+
+int sha1_file(const char* path, unsigned char hash[SHA1_LENGTH]) {
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) return 1;
+	struct stat statbuf;
+	if (fstat(fd, &statbuf)) {close(fd); return 1;}
+	// mapping big files, which saves copying them
+	if (S_ISREG(statbuf.st_mode) && statbuf.st_size >= FILE_MAP_MIN) {
+		void* map = mmap(NULL, statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map != MAP_FAILED) {
+			close(fd);
+			madvise(map, statbuf.st_size, MADV_SEQUENTIAL);
+			sha1_data(map, statbuf.st_size, hash);
+			munmap(map, statbuf.st_size);
+			return 0;
+		}
+	}
+	// reading anything else
+	unsigned char* buffer = malloc(FILE_BUFFER_SIZE);
+	if (!buffer) {close(fd); return 1;}
+	struct SHA1 sha;
+	sha1_init(&sha);
+	ssize_t length;
+	while ((length = read(fd, buffer, FILE_BUFFER_SIZE)) > 0) sha1_update(&sha, buffer, length);
+	free(buffer);
+	close(fd);
+	if (length < 0) return 1;
+	sha1_final(&sha, hash);
+	return 0;
+}
+
+// files being hashed across threads, which each take the next file until none are left
+struct SHA1Files {
+	const char** paths;
+	unsigned char (*hashes)[SHA1_LENGTH];
+	char* errors;
+	size_t count;
+	size_t next;
+	pthread_mutex_t lock;
+};
+
+void* sha1_files_work(void* data) {
+	struct SHA1Files* files = data;
+	for (;;) {
+		pthread_mutex_lock(&files->lock);
+		size_t i = files->next++;
+		pthread_mutex_unlock(&files->lock);
+		if (i >= files->count) return NULL;
+		files->errors[i] = sha1_file(files->paths[i], files->hashes[i]);
+	}
+}
+
+void sha1_files(size_t count, const char** paths, unsigned char (*hashes)[SHA1_LENGTH], char* errors) {
+	struct SHA1Files files = {paths, hashes, errors, count, 0};
+	pthread_mutex_init(&files.lock, NULL);
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t threadc = cpus > 1 ? cpus : 1;
+	if (threadc > SHA1_THREADS) threadc = SHA1_THREADS;
+	if (threadc > count) threadc = count;
+	// this thread works too, so one fewer is started
+	pthread_t threads[SHA1_THREADS];
+	size_t started = 0;
+	while (started + 1 < threadc && !pthread_create(&threads[started], NULL, sha1_files_work, &files)) started++;
+	sha1_files_work(&files);
+	for (size_t i = 0; i < started; i++) pthread_join(threads[i], NULL);
+	pthread_mutex_destroy(&files.lock);
+}
+
+int sha1_from_hex(const char* hex, unsigned char hash[SHA1_LENGTH]) {
+	for (int i = 0; i < SHA1_LENGTH * 2; i++) {
+		char c = hex[i];
+		int nibble;
+		if (c >= '0' && c <= '9') nibble = c - '0';
+		else if (c >= 'a' && c <= 'f') nibble = c - 'a' + 10;
+		else if (c >= 'A' && c <= 'F') nibble = c - 'A' + 10;
+		else return 1;
+		if (i % 2) hash[i / 2] |= nibble;
+		else hash[i / 2] = nibble << 4;
+	}
+	return 0;
+}
\ No newline at end of file
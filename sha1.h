@@ -0,0 +1,21 @@
+/* sha-1 hashing
+   used to compare local files against the hashes neocities reports.
+   blocks are hashed with sha-ni on x86-64 or the sha1 instructions on armv8 where the cpu has them.
+   big files are memory-mapped, and lists of files are hashed on several threads */
+
+#define SHA1_LENGTH 20
+
+// hashes `size` bytes at `data` into `hash`
+void sha1_data(const void* data, size_t size, unsigned char hash[SHA1_LENGTH]);
+
+// hashes the contents of the file at `path` into `hash`
+// returns 0 on success, or 1 if the file couldn't be read
+int sha1_file(const char* path, unsigned char hash[SHA1_LENGTH]);
+
+// hashes each of the `count` files at `paths` into `hashes`, spread across threads
+// `errors` is set for each file, to 0 if it was hashed or 1 if it couldn't be read
+void sha1_files(size_t count, const char** paths, unsigned char (*hashes)[SHA1_LENGTH], char* errors);
+
+// reads a 40-character hex string at `hex` into `hash`
+// returns 0 on success, or 1 if `hex` isn't a valid hash
+int sha1_from_hex(const char* hex, unsigned char hash[SHA1_LENGTH]);
\ No newline at end of file
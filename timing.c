@@ -0,0 +1,155 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "timing.h"
+
+#define TIMING_REALLOC_STEP 32
+
+struct TimingPhase {
+	const char* name;
+	double seconds;
+};
+
+struct TimingRequest {
+	char* url;
+	double namelookup;
+	double connect;
+	double appconnect;
+	double starttransfer;
+	double total;
+	long long bytes_up;
+	long long bytes_down;
+	long long speed_up;
+	long long speed_down;
+};
+
+struct Timings {
+	int enabled;
+	int json;
+	double start; // of the whole run
+	double phase_start; // of the running phase
+	const char* phase; // null between phases
+	struct TimingPhase* phases;
+	size_t phase_count;
+	struct TimingRequest* requests;
+	size_t request_count;
+	size_t hashed_files;
+	unsigned long long hashed_bytes;
+	double hashed_seconds;
+} timings;
+
+/* helpers */
+
+// returns monotonic time in seconds
+double timing_now(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// grows an array of `count` `unit`-sized items to fit one more. returns 0 on success
+int timing_grow(void** array_p, size_t count, size_t unit) {
+	if (count % TIMING_REALLOC_STEP) return 0;
+	void* array = realloc(*array_p, (count + TIMING_REALLOC_STEP) * unit);
+	if (!array) return 1;
+	*array_p = array;
+	return 0;
+}
+
+// prints `string` as a json string
+void timing_print_string(const char* string) {
+	fputc('"', stderr);
+	for (; *string; string++) {
+		if (*string == '"' || *string == '\\') fputc('\\', stderr);
+		fputc(*string, stderr);
+	}
+	fputc('"', stderr);
+}
+
+void timing_report_text(void) {
+	fprintf(stderr, "\ntimings:\n");
+	for (size_t i = 0; i < timings.phase_count; i++)
+		fprintf(stderr, "    %-10s %10.1f ms\n", timings.phases[i].name, timings.phases[i].seconds * 1000);
+	fprintf(stderr, "    %-10s %10.1f ms\n", "total", (timing_now() - timings.start) * 1000);
+	if (timings.hashed_files) fprintf(stderr, "hashed %zu files, %llu bytes in %.1f ms (%.2f GB/s)\n", timings.hashed_files,
+		timings.hashed_bytes, timings.hashed_seconds * 1000, timings.hashed_seconds > 0 ? timings.hashed_bytes / timings.hashed_seconds / 1e9 : 0);
+	if (!timings.request_count) return;
+	fprintf(stderr, "requests:\n");
+	for (size_t i = 0; i < timings.request_count; i++) {
+		struct TimingRequest* request = &timings.requests[i];
+		fprintf(stderr, "    %s\n", request->url);
+		fprintf(stderr, "      dns %.1f  connect %.1f  tls %.1f  first byte %.1f  total %.1f ms\n",
+			request->namelookup * 1000, request->connect * 1000, request->appconnect * 1000, request->starttransfer * 1000, request->total * 1000);
+		fprintf(stderr, "      up %lld bytes (%lld/s)  down %lld bytes (%lld/s)\n",
+			request->bytes_up, request->speed_up, request->bytes_down, request->speed_down);
+	}
+}
+
+void timing_report_json(void) {
+	fprintf(stderr, "{\"total_ms\":%.3f,\"phases\":[", (timing_now() - timings.start) * 1000);
+	for (size_t i = 0; i < timings.phase_count; i++) {
+		fprintf(stderr, "%s{\"name\":", i ? "," : "");
+		timing_print_string(timings.phases[i].name);
+		fprintf(stderr, ",\"ms\":%.3f}", timings.phases[i].seconds * 1000);
+	}
+	fprintf(stderr, "],\"hashed\":{\"files\":%zu,\"bytes\":%llu,\"ms\":%.3f}", timings.hashed_files, timings.hashed_bytes, timings.hashed_seconds * 1000);
+	fprintf(stderr, ",\"requests\":[");
+	for (size_t i = 0; i < timings.request_count; i++) {
+		struct TimingRequest* request = &timings.requests[i];
+		fprintf(stderr, "%s{\"url\":", i ? "," : "");
+		timing_print_string(request->url);
+		fprintf(stderr, ",\"namelookup_ms\":%.3f,\"connect_ms\":%.3f,\"appconnect_ms\":%.3f,\"starttransfer_ms\":%.3f,\"total_ms\":%.3f",
+			request->namelookup * 1000, request->connect * 1000, request->appconnect * 1000, request->starttransfer * 1000, request->total * 1000);
+		fprintf(stderr, ",\"bytes_up\":%lld,\"bytes_down\":%lld,\"speed_up\":%lld,\"speed_down\":%lld}",
+			request->bytes_up, request->bytes_down, request->speed_up, request->speed_down);
+	}
+	fprintf(stderr, "]}\n");
+}
+
+/* interface */
+
+void timing_enable(int json) {
+	timings.enabled = 1;
+	timings.json = json;
+	timings.start = timing_now();
+}
+
+int timing_enabled(void) {
+	return timings.enabled;
+}
+
+void timing_phase(const char* name) {
+	if (!timings.enabled) return;
+	double now = timing_now();
+	if (timings.phase && !timing_grow((void**)&timings.phases, timings.phase_count, sizeof(struct TimingPhase)))
+		timings.phases[timings.phase_count++] = (struct TimingPhase){timings.phase, now - timings.phase_start};
+	timings.phase = name;
+	timings.phase_start = now;
+}
+
+void timing_request(const char* url, double namelookup, double connect, double appconnect, double starttransfer, double total,
+long long bytes_up, long long bytes_down, long long speed_up, long long speed_down) {
+	if (!timings.enabled || timing_grow((void**)&timings.requests, timings.request_count, sizeof(struct TimingRequest))) return;
+	char* copy = strdup(url ? url : "");
+	if (!copy) return;
+	timings.requests[timings.request_count++] = (struct TimingRequest){copy, namelookup, connect, appconnect, starttransfer, total,
+		bytes_up, bytes_down, speed_up, speed_down};
+}
+
+void timing_hashed(size_t files, unsigned long long bytes, double seconds) {
+	if (!timings.enabled) return;
+	timings.hashed_files += files;
+	timings.hashed_bytes += bytes;
+	timings.hashed_seconds += seconds;
+}
+
+void timing_report(void) {
+	if (!timings.enabled) return;
+	timing_phase(NULL);
+	if (timings.json) timing_report_json();
+	else timing_report_text();
+	for (size_t i = 0; i < timings.request_count; i++) free(timings.requests[i].url);
+	free(timings.requests);
+	free(timings.phases);
+}
\ No newline at end of file
@@ -0,0 +1,27 @@
+/* timings
+   records how long each phase of a command takes, and where each request spent its time.
+   nothing is recorded until timings are enabled. the report is printed to stderr,
+   either as text or as a single json object */
+
+// starts recording. `json` selects the report format
+void timing_enable(int json);
+
+// returns whether timings are being recorded
+int timing_enabled(void);
+
+// ends the running phase, and starts a phase called `name` unless it's null
+// time between phases (eg. waiting for input) isn't counted
+void timing_phase(const char* name);
+
+// records a finished request to `url`. times are in seconds since the request started, and speeds are in bytes per second
+void timing_request(const char* url, double namelookup, double connect, double appconnect, double starttransfer, double total,
+	long long bytes_up, long long bytes_down, long long speed_up, long long speed_down);
+
+// records `files` files totalling `bytes` bytes being hashed in `seconds`
+void timing_hashed(size_t files, unsigned long long bytes, double seconds);
+
+// ends the running phase and prints everything recorded
+void timing_report(void);
+
+// returns monotonic time in seconds
+double timing_now(void);
\ No newline at end of file
@@ -0,0 +1,213 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "arena.h"
+#include "cli.h"
+#include "ignore.h"
+#include "walk.h"
+
+#define WALK_THREADS 8
+#define PATH_LIST_INITIAL_CAP 256
+#define NAMES_INITIAL_CAP 4096
+
+// state shared between walking threads
+// directories waiting to be read are kept on a stack, which idle threads take from
+struct Walk {
+	struct PathList* list; // also holds the stacked directory paths
+	const struct Ignore* ignore;
+	char** stack;
+	size_t size;
+	size_t cap;
+	size_t busy; // threads currently reading a directory
+	int error;
+	pthread_mutex_t lock;
+	pthread_cond_t ready; // signaled when directories are stacked, or the walk ends
+};
+
+// entry names read from one directory, each stored as a kind byte ('d' or 'f') followed by a null-terminated name
+struct WalkNames {
+	char* data;
+	size_t length;
+	size_t cap;
+};
+
+/* path list */
+
+int path_list_create(struct PathList* list) {
+	*list = (struct PathList){NULL, 0, 0, arena_create()};
+	return !list->arena;
+}
+
+// adds a path already allocated from the list's arena. returns 1 if memory couldn't be allocated
+int path_list_push(struct PathList* list, char* path) {
+	if (list->count == list->cap) {
+		size_t cap = list->cap ? list->cap * 2 : PATH_LIST_INITIAL_CAP;
+		char** paths = realloc(list->paths, cap * sizeof(char*));
+		if (!paths) return 1;
+		list->paths = paths;
+		list->cap = cap;
+	}
+	list->paths[list->count++] = path;
+	return 0;
+}
+
+int path_list_add(struct PathList* list, const char* path, size_t length) {
+	char* copy = arena_alloc(list->arena, length + 1);
+	if (!copy) return 1;
+	memcpy(copy, path, length);
+	copy[length] = 0;
+	return path_list_push(list, copy);
+}
+
+void path_list_destroy(struct PathList* list) {
+	free(list->paths);
+	arena_destroy(list->arena);
+}
+
+/* helpers */
+
+// returns `name` joined onto the directory `path`, allocated from `arena`
+char* walk_join(struct Arena* arena, const char* path, const char* name) {
+	size_t path_length = strcmp(path, ".") ? strlen(path) : 0;
+	size_t name_length = strlen(name);
+	int separator = path_length && path[path_length - 1] != '/';
+	char* joined = arena_alloc(arena, path_length + separator + name_length + 1);
+	if (!joined) return NULL;
+	memcpy(joined, path, path_length);
+	if (separator) joined[path_length] = '/';
+	memcpy(joined + path_length + separator, name, name_length + 1);
+	return joined;
+}
+
+// adds an entry name to `names`. returns 1 if memory couldn't be allocated
+int walk_names_add(struct WalkNames* names, char kind, const char* name) {
+	size_t size = strlen(name) + 2;
+	if (names->length + size > names->cap) {
+		size_t cap = names->cap ? names->cap : NAMES_INITIAL_CAP;
+		while (names->length + size > cap) cap *= 2;
+		char* data = realloc(names->data, cap);
+		if (!data) return 1;
+		names->data = data;
+		names->cap = cap;
+	}
+	names->data[names->length] = kind;
+	memcpy(names->data + names->length + 1, name, size - 1);
+	names->length += size;
+	return 0;
+}
+
+// reads the entries of the directory at `path` into `names`, without holding the lock
+// entries are only stat-ed when the directory doesn't give their type, and ignored entries are left out
+// returns 1 if memory couldn't be allocated
+int walk_read(struct Walk* walk, const char* path, struct WalkNames* names) {
+	names->length = 0;
+	int fd = open(path, O_RDONLY | O_DIRECTORY);
+	DIR* dir = fd < 0 ? NULL : fdopendir(fd);
+	if (!dir) {
+		if (fd >= 0) close(fd);
+		pthread_mutex_lock(&walk->lock);
+		print_error("couldn't open directory: %s", path);
+		pthread_mutex_unlock(&walk->lock);
+		return 0;
+	}
+	size_t length = strcmp(path, ".") ? strlen(path) : 0;
+	const char* separator = length && path[length - 1] != '/' ? "/" : "";
+	struct dirent* entry;
+	int error = 0;
+	while (!error && (entry = readdir(dir))) {
+		if (*entry->d_name == '.') continue;
+		int is_dir = entry->d_type == DT_DIR;
+		if (entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK) {
+			struct stat statbuf;
+			if (fstatat(fd, entry->d_name, &statbuf, 0)) {
+				pthread_mutex_lock(&walk->lock);
+				print_error("couldn't find file: %.*s%s%s", (int)length, path, separator, entry->d_name);
+				pthread_mutex_unlock(&walk->lock);
+				continue;
+			}
+			is_dir = S_ISDIR(statbuf.st_mode);
+		}
+		char joined[length + strlen(entry->d_name) + 2];
+		sprintf(joined, "%.*s%s%s", (int)length, path, separator, entry->d_name);
+		if (ignore_match(walk->ignore, joined, is_dir)) continue;
+		error = walk_names_add(names, is_dir ? 'd' : 'f', entry->d_name);
+	}
+	closedir(dir);
+	return error;
+}
+
+// adds the entries read from the directory at `path` to the list + stack. must hold the lock
+// returns 1 if memory couldn't be allocated
+int walk_publish(struct Walk* walk, const char* path, const struct WalkNames* names) {
+	for (size_t i = 0; i < names->length; i += strlen(names->data + i + 1) + 2) {
+		char* joined = walk_join(walk->list->arena, path, names->data + i + 1);
+		if (!joined) return 1;
+		// file
+		if (names->data[i] == 'f') {
+			if (path_list_push(walk->list, joined)) return 1;
+			continue;
+		}
+		// dir
+		if (walk->size == walk->cap) {
+			size_t cap = walk->cap * 2;
+			char** stack = realloc(walk->stack, cap * sizeof(char*));
+			if (!stack) return 1;
+			walk->stack = stack;
+			walk->cap = cap;
+		}
+		walk->stack[walk->size++] = joined;
+	}
+	return 0;
+}
+
+// reads stacked directories until none are left and no other thread can stack more
+void* walk_thread(void* data) {
+	struct Walk* walk = data;
+	struct WalkNames names = {0};
+	pthread_mutex_lock(&walk->lock);
+	while (1) {
+		while (!walk->size && walk->busy && !walk->error) pthread_cond_wait(&walk->ready, &walk->lock);
+		if (!walk->size || walk->error) break;
+		const char* path = walk->stack[--walk->size];
+		walk->busy++;
+		pthread_mutex_unlock(&walk->lock);
+		int error = walk_read(walk, path, &names);
+		pthread_mutex_lock(&walk->lock);
+		if (error || walk_publish(walk, path, &names)) walk->error = 1;
+		walk->busy--;
+		pthread_cond_broadcast(&walk->ready);
+	}
+	pthread_mutex_unlock(&walk->lock);
+	free(names.data);
+	return NULL;
+}
+
+/* interface */
+
+int walk_paths(struct PathList* list, const char* path, const struct Ignore* ignore) {
+	if (*path == '.' && path[1] == '/') path = path[2] ? path + 2 : ".";
+	struct stat statbuf;
+	if (stat(path, &statbuf)) {print_error("couldn't find file: %s", path); return 0;}
+	if (strcmp(path, ".") && ignore_match(ignore, path, S_ISDIR(statbuf.st_mode))) return 0;
+	if (!S_ISDIR(statbuf.st_mode)) return path_list_add(list, path, strlen(path));
+	// walking from the directory on every thread
+	struct Walk walk = {list, ignore, malloc(WALK_THREADS * sizeof(char*)), 1, WALK_THREADS, 0, 0};
+	if (!walk.stack) return 1;
+	walk.stack[0] = (char*)path;
+	pthread_mutex_init(&walk.lock, NULL);
+	pthread_cond_init(&walk.ready, NULL);
+	pthread_t threads[WALK_THREADS - 1];
+	size_t threadc = 0;
+	while (threadc < WALK_THREADS - 1 && !pthread_create(&threads[threadc], NULL, walk_thread, &walk)) threadc++;
+	walk_thread(&walk);
+	for (size_t i = 0; i < threadc; i++) pthread_join(threads[i], NULL);
+	pthread_cond_destroy(&walk.ready);
+	pthread_mutex_destroy(&walk.lock);
+	free(walk.stack);
+	return walk.error;
+}
\ No newline at end of file
@@ -0,0 +1,31 @@
+/* directory walking
+   lists every file beneath a directory, reading several directories at once on separate threads.
+   hidden files + directories (those starting with a dot) are skipped, as are those excluded by ignore rules.
+   excluded directories are never opened */
+
+struct Arena;
+struct Ignore;
+
+// a list of paths, all allocated from one arena
+struct PathList {
+	char** paths;
+	size_t count;
+	size_t cap;
+	struct Arena* arena;
+};
+
+// initializes an empty list
+// returns 0 on success, or 1 if memory couldn't be allocated
+int path_list_create(struct PathList* list);
+
+// copies `length` bytes of `path` into a new path at the end of `list`
+// returns 0 on success, or 1 if memory couldn't be allocated
+int path_list_add(struct PathList* list, const char* path, size_t length);
+
+void path_list_destroy(struct PathList* list);
+
+// adds `path` to `list` if it's a file, or every file beneath it if it's a directory, in no particular order
+// paths that can't be found or opened are reported and skipped
+// `ignore` may be null
+// returns 0 on success, or 1 if memory couldn't be allocated
+int walk_paths(struct PathList* list, const char* path, const struct Ignore* ignore);
\ No newline at end of file
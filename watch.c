@@ -0,0 +1,204 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+#include "cli.h"
+#include "ignore.h"
+#include "walk.h"
+#include "watch.h"
+
+#ifdef __linux__
+
+#define WATCH_MASK (IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR)
+#define WATCH_BUFFER_SIZE 65536
+#define WATCH_REALLOC_STEP 64
+
+// a change to one path, numbered so the last change to each path can be found once they're sorted
+struct WatchEvent {
+	char* path;
+	size_t order;
+	int removed;
+};
+
+struct Watch {
+	int fd;
+	const struct Ignore* ignore;
+	char** dirs; // the path of the directory behind each watch descriptor, or null. the root is ""
+	size_t dir_count; // one past the highest descriptor that fits
+	struct WatchEvent* events; // changes collected since the last wait
+	size_t event_count;
+	size_t event_cap;
+};
+
+/* helpers */
+
+// returns `name` joined onto the directory at `dir`, which must be freed, or null if memory couldn't be allocated
+char* watch_join(const char* dir, const char* name) {
+	char* path = malloc(strlen(dir) + strlen(name) + 2);
+	if (path) sprintf(path, "%s%s%s", dir, *dir ? "/" : "", name);
+	return path;
+}
+
+// watches the directory at `path` and every directory beneath it that isn't hidden or ignored
+// directories that can't be watched are reported and skipped
+// returns 0 on success, or 1 if memory couldn't be allocated
+int watch_add(struct Watch* watch, const char* path) {
+	int wd = inotify_add_watch(watch->fd, *path ? path : ".", WATCH_MASK);
+	if (wd < 0) {print_error("couldn't watch directory: %s", *path ? path : "."); return 0;}
+	if ((size_t)wd >= watch->dir_count) {
+		char** dirs = realloc(watch->dirs, (wd + WATCH_REALLOC_STEP) * sizeof(char*));
+		if (!dirs) return 1;
+		memset(dirs + watch->dir_count, 0, (wd + WATCH_REALLOC_STEP - watch->dir_count) * sizeof(char*));
+		watch->dirs = dirs;
+		watch->dir_count = wd + WATCH_REALLOC_STEP;
+	}
+	// a directory reached twice (eg. through a symlink) keeps its first path
+	if (watch->dirs[wd]) return 0;
+	if (!(watch->dirs[wd] = strdup(path))) return 1;
+	// watching subdirectories
+	DIR* dir = opendir(*path ? path : ".");
+	if (!dir) return 0;
+	struct dirent* entry;
+	int error = 0;
+	while (!error && (entry = readdir(dir))) {
+		if (*entry->d_name == '.') continue;
+		int is_dir = entry->d_type == DT_DIR;
+		if (entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK) {
+			struct stat statbuf;
+			is_dir = !fstatat(dirfd(dir), entry->d_name, &statbuf, 0) && S_ISDIR(statbuf.st_mode);
+		}
+		if (!is_dir) continue;
+		char* subdir = watch_join(path, entry->d_name);
+		if (!subdir) error = 1;
+		else if (!ignore_match(watch->ignore, subdir, 1)) error = watch_add(watch, subdir);
+		free(subdir);
+	}
+	closedir(dir);
+	return error;
+}
+
+// stops watching the directory at `path` and everything beneath it, as it's been moved out or deleted
+void watch_forget(struct Watch* watch, const char* path) {
+	size_t length = strlen(path);
+	for (size_t i = 0; i < watch->dir_count; i++) {
+		const char* dir = watch->dirs[i];
+		if (!dir || strncmp(dir, path, length) || (dir[length] && dir[length] != '/')) continue;
+		inotify_rm_watch(watch->fd, i);
+		free(watch->dirs[i]);
+		watch->dirs[i] = NULL;
+	}
+}
+
+// records a change to `path`, taking ownership of it
+// returns 0 on success, or 1 if memory couldn't be allocated
+int watch_record(struct Watch* watch, char* path, int removed) {
+	if (watch->event_count == watch->event_cap) {
+		struct WatchEvent* events = realloc(watch->events, (watch->event_cap + WATCH_REALLOC_STEP) * sizeof(struct WatchEvent));
+		if (!events) {free(path); return 1;}
+		watch->events = events;
+		watch->event_cap += WATCH_REALLOC_STEP;
+	}
+	watch->events[watch->event_count] = (struct WatchEvent){path, watch->event_count, removed};
+	watch->event_count++;
+	return 0;
+}
+
+// reads pending inotify events into recorded changes
+// returns 0 on success, or 1 if memory couldn't be allocated
+int watch_read(struct Watch* watch) {
+	char buffer[WATCH_BUFFER_SIZE] __attribute__((aligned(__alignof__(struct inotify_event))));
+	ssize_t length = read(watch->fd, buffer, sizeof(buffer));
+	const struct inotify_event* event;
+	for (char* position = buffer; length > 0 && position < buffer + length; position += sizeof(struct inotify_event) + event->len) {
+		event = (const struct inotify_event*)position;
+		if (event->mask & IN_Q_OVERFLOW) {print_error("missed some changes, run sync to catch up"); continue;}
+		if (event->wd < 0 || (size_t)event->wd >= watch->dir_count || !watch->dirs[event->wd]) continue;
+		// the directory is gone, and so is its watch
+		if (event->mask & IN_IGNORED) {free(watch->dirs[event->wd]); watch->dirs[event->wd] = NULL; continue;}
+		if (!event->len || *event->name == '.') continue;
+		int is_dir = !!(event->mask & IN_ISDIR);
+		int removed = !!(event->mask & (IN_DELETE | IN_MOVED_FROM));
+		// created files are recorded once they're written
+		if (!is_dir && event->mask & IN_CREATE) continue;
+		char* path = watch_join(watch->dirs[event->wd], event->name);
+		if (!path) return 1;
+		if (ignore_match(watch->ignore, path, is_dir)) {free(path); continue;}
+		if (is_dir && removed) watch_forget(watch, path);
+		else if (is_dir && watch_add(watch, path)) {free(path); return 1;}
+		if (watch_record(watch, path, removed)) return 1;
+	}
+	return 0;
+}
+
+int watch_event_sort(const void* a, const void* b) {
+	const struct WatchEvent* event_a = a;
+	const struct WatchEvent* event_b = b;
+	int cmp = strcmp(event_a->path, event_b->path);
+	if (cmp) return cmp;
+	return event_a->order < event_b->order ? -1 : event_a->order > event_b->order;
+}
+
+/* interface */
+
+struct Watch* watch_create(const struct Ignore* ignore) {
+	struct Watch* watch = calloc(1, sizeof(struct Watch));
+	if (!watch) {print_error(ERROR_ALLOCATION); return NULL;}
+	watch->ignore = ignore;
+	if ((watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0) {print_error("couldn't start watching"); free(watch); return NULL;}
+	if (watch_add(watch, "")) {print_error(ERROR_ALLOCATION); watch_destroy(watch); return NULL;}
+	return watch;
+}
+
+int watch_wait(struct Watch* watch, int debounce, struct PathList* changed, struct PathList* removed) {
+	// waiting for a change, then for changes to stop
+	struct pollfd pollfd = {watch->fd, POLLIN, 0};
+	int error = 0;
+	for (;;) {
+		int ready = poll(&pollfd, 1, watch->event_count ? debounce : -1);
+		if (ready < 0 && errno != EINTR) {print_error("couldn't wait for changes"); return 1;}
+		if (!ready) break;
+		if (ready > 0 && watch_read(watch)) {print_error(ERROR_ALLOCATION); error = 1; break;}
+	}
+	// keeping only the last change to each path
+	qsort(watch->events, watch->event_count, sizeof(struct WatchEvent), watch_event_sort);
+	for (size_t i = 0; i < watch->event_count; i++) {
+		const struct WatchEvent* event = &watch->events[i];
+		int last = i + 1 == watch->event_count || strcmp(event->path, watch->events[i + 1].path);
+		if (!error && last && path_list_add(event->removed ? removed : changed, event->path, strlen(event->path))) {print_error(ERROR_ALLOCATION); error = 1;}
+		free(watch->events[i].path);
+	}
+	watch->event_count = 0;
+	return error;
+}
+
+void watch_destroy(struct Watch* watch) {
+	if (!watch) return;
+	for (size_t i = 0; i < watch->event_count; i++) free(watch->events[i].path);
+	for (size_t i = 0; i < watch->dir_count; i++) free(watch->dirs[i]);
+	free(watch->events);
+	free(watch->dirs);
+	close(watch->fd);
+	free(watch);
+}
+
+#else
+
+struct Watch* watch_create(const struct Ignore* ignore) {
+	print_error("watching is only supported on linux");
+	return NULL;
+}
+
+int watch_wait(struct Watch* watch, int debounce, struct PathList* changed, struct PathList* removed) {
+	return 1;
+}
+
+void watch_destroy(struct Watch* watch) {}
+
+#endif
\ No newline at end of file
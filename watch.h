@@ -0,0 +1,21 @@
+/* directory watching
+   follows changes beneath the site root with inotify, so they can be mirrored as they happen.
+   every directory a walk would open is watched, and directories created later are watched as they appear.
+   bursts of events are coalesced, leaving only the last change to each path. only available on linux */
+
+struct Ignore;
+struct PathList;
+
+struct Watch;
+
+// starts watching the site root, skipping hidden + ignored directories. `ignore` may be null, and must outlive the watch
+// returns null on failure, after printing an error
+struct Watch* watch_create(const struct Ignore* ignore);
+
+// waits for changes, then collects them until none arrive for `debounce` milliseconds
+// paths written or moved in are added to `changed`, and paths removed or moved out are added to `removed`.
+// new directories are added to `changed` whole, as files may have been written to them before they were watched
+// returns 0 on success, or 1 on failure, after printing an error
+int watch_wait(struct Watch* watch, int debounce, struct PathList* changed, struct PathList* removed);
+
+void watch_destroy(struct Watch* watch);
\ No newline at end of file